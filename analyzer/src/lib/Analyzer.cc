@@ -11,6 +11,7 @@
 #include "llvm/IR/Verifier.h"
 #include "llvm/Bitcode/BitcodeReader.h"
 #include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/ToolOutputFile.h"
@@ -20,10 +21,16 @@
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/Path.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Operator.h"
 
 #include <memory>
 #include <vector>
 #include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fcntl.h>
 #include <sys/resource.h>
 
 #include "Analyzer.h"
@@ -33,12 +40,13 @@
 #include "MissingChecks.h"
 #include "PointerAnalysis.h"
 #include "TypeInitializer.h"
+#include "BitcodeIndex.h"
 
 using namespace llvm;
 
 // Command line parameters.
 cl::list<string> InputFilenames(             
-    cl::Positional, cl::OneOrMore, cl::desc("<input bitcode files>"));    // cl::OneOrMore：控制在程序的命令行上允许（或要求）指定选项的次数,至少1次
+    cl::Positional, cl::ZeroOrMore, cl::desc("<input bitcode files>"));    // cl::OneOrMore：控制在程序的命令行上允许（或要求）指定选项的次数,至少1次
                                                                           // cl::Positional: 这是一个没有与之关联的命令行选项的位置参数
 cl::opt<unsigned> VerboseLevel(
     "verbose-level", cl::desc("Print information at which verbose level"),   // cl::desc参数，说明该命令行选项的作用是什么; 如果是单独写一个程序，在main函数的开头写如下代码：
@@ -55,6 +63,154 @@ cl::opt<bool> MissingChecks(
 		cl::desc("Identify missing-check bugs"),
 		cl::NotHidden, cl::init(false));    // cl::init()：设定初始值。cl::Optional表明该选项是可选的。
 
+cl::list<string> FocusFuncNames(
+		"focus",
+		cl::desc("Only analyze the call-graph neighborhood of these functions"),
+		cl::CommaSeparated, cl::NotHidden);
+
+cl::opt<bool> FocusTestFuncs(
+		"focus-test-funcs",
+		cl::desc("Focus on the functions in configs/test-funcs"),
+		cl::NotHidden, cl::init(false));
+
+cl::opt<unsigned> FocusDepth(
+		"focus-depth",
+		cl::desc("Depth of callers and callees included in focus mode"),
+		cl::NotHidden, cl::init(1));
+
+cl::opt<string> BuildIndexFile(
+		"build-index",
+		cl::desc("Index the functions of the input bitcode files into this file, and exit"),
+		cl::NotHidden, cl::init(""));
+
+cl::opt<string> IndexFile(
+		"index",
+		cl::desc("Load the modules defining called functions on demand, using this index"),
+		cl::NotHidden, cl::init(""));
+
+cl::opt<unsigned> IndexDepth(
+		"index-depth",
+		cl::desc("Levels of callees whose modules are loaded on demand"),
+		cl::NotHidden, cl::init(1));
+
+cl::opt<bool> IndexIndirect(
+		"index-indirect",
+		cl::desc("Also load on demand the modules taking addresses of functions"),
+		cl::NotHidden, cl::init(false));
+
+cl::opt<bool> SummaryCallGraph(
+		"summary-cg",
+		cl::desc("Build the call graph from module summaries, loading function bodies only for analyzed functions"),
+		cl::NotHidden, cl::init(false));
+
+cl::opt<bool> SharedContext(
+		"shared-context",
+		cl::desc("Load all modules into a single LLVMContext, so that same types are unified"),
+		cl::NotHidden, cl::init(false));
+
+cl::opt<string> MCStatsFile(
+		"mc-stats",
+		cl::desc("Save the statistics of missing checks into this file, for re-ranking"),
+		cl::NotHidden, cl::init(""));
+
+cl::opt<string> RerankFile(
+		"rerank",
+		cl::desc("Report missing checks from this statistics file, without loading bitcode"),
+		cl::NotHidden, cl::init(""));
+
+// Report options, whose defaults are configured in MissingChecks.cc
+cl::opt<double, true> SrcThreshold(
+		"src-threshold",
+		cl::desc("Highest uncheck rating of reported sources"),
+		cl::location(MissingChecksPass::ReportOpts.SrcThreshold),
+		cl::NotHidden);
+
+cl::opt<double, true> UseThreshold(
+		"use-threshold",
+		cl::desc("Highest uncheck rating of reported uses"),
+		cl::location(MissingChecksPass::ReportOpts.UseThreshold),
+		cl::NotHidden);
+
+cl::opt<bool, true> AddrTakenOnly(
+		"addrtaken-only",
+		cl::desc("Only report sources and uses in address-taken functions"),
+		cl::location(MissingChecksPass::ReportOpts.AddrTakenOnly),
+		cl::NotHidden);
+
+cl::opt<bool, true> ReportSrc(
+		"report-src",
+		cl::desc("Report missing checks of sources"),
+		cl::location(MissingChecksPass::ReportOpts.ReportSrc),
+		cl::NotHidden);
+
+cl::opt<bool, true> ReportUse(
+		"report-use",
+		cl::desc("Report missing checks of uses"),
+		cl::location(MissingChecksPass::ReportOpts.ReportUse),
+		cl::NotHidden);
+
+cl::opt<string, true> ReportFile(
+		"report",
+		cl::desc("Write the report of missing checks into this file"),
+		cl::location(MissingChecksPass::ReportOpts.File),
+		cl::NotHidden);
+
+cl::opt<MCReportFormat, true> ReportFormat(
+		"report-format",
+		cl::desc("Format of the report of missing checks"),
+		cl::values(
+			clEnumValN(RF_TEXT, "text", "Colored text (default)"),
+			clEnumValN(RF_JSONL, "jsonl", "One JSON object per line"),
+			clEnumValN(RF_SARIF, "sarif", "SARIF 2.1.0")),
+		cl::location(MissingChecksPass::ReportOpts.Format),
+		cl::NotHidden);
+
+cl::opt<bool, true> ReportStream(
+		"report-stream",
+		cl::desc("Report missing checks during the analysis, as soon as they are final"),
+		cl::location(MissingChecksPass::ReportOpts.Stream),
+		cl::NotHidden);
+
+cl::opt<unsigned> Deadline(
+		"deadline",
+		cl::desc("Stop detecting missing checks after this many seconds, reporting partial results"),
+		cl::NotHidden, cl::init(0));
+
+cl::opt<bool> SampleStage2(
+		"sample-stage2",
+		cl::desc("Slice a sample of the call sites of each callee first in stage 2, skipping sources and uses confidently above the thresholds; faster, but may miss reports"),
+		cl::NotHidden, cl::init(false));
+
+cl::opt<unsigned> NumThreads(
+		"analysis-threads",
+		cl::desc("Number of threads analyzing functions in parallel"),
+		cl::NotHidden, cl::init(1));
+
+cl::opt<unsigned> LoadThreads(
+		"load-threads",
+		cl::desc("Number of threads reading and parsing bitcode files ahead"),
+		cl::NotHidden, cl::init(1));
+
+cl::opt<unsigned> PACacheSize(
+		"pa-cache",
+		cl::desc("Compute pointer analysis results on demand, keeping those of at most this many functions"),
+		cl::NotHidden, cl::init(0));
+
+cl::opt<bool> EntryReach(
+		"entry-reach",
+		cl::desc("Only analyze functions reachable from syscalls, handlers of user-facing operations and callers of data-fetch functions"),
+		cl::NotHidden, cl::init(false));
+
+cl::opt<string> SaveCoreSummaryFile(
+		"save-core-summary",
+		cl::desc("Save the exported functions and their statistics of missing checks into this file, to analyze drivers against"),
+		cl::NotHidden, cl::init(""));
+
+cl::opt<string> CoreSummaryFile(
+		"core-summary",
+		cl::desc("Analyze the modules, e.g., of a driver, against this core summary instead of loading the core kernel"),
+		cl::NotHidden, cl::init(""));
+
 
 GlobalContext GlobalCtx;   // NumSecurityChecks, NumCondStatements的个数，等定义
 
@@ -73,25 +229,34 @@ void IterativeModulePass::run(ModuleList &modules) {
   }
   OP << "\n";
 
-  unsigned iter = 0, changed = 1;
-  while (changed) {
-    ++iter;
-    changed = 0;
-    unsigned counter_modules = 0;
-    unsigned total_modules = modules.size();
-    for (i = modules.begin(), e = modules.end(); i != e; ++i) {
-      OP << "[" << ID << " / " << iter << "] ";
-      OP << "[" << ++counter_modules << " / " << total_modules << "] ";
-      OP << "[" << i->second << "]\n";
-
-      bool ret = doModulePass(i->first);
-      if (ret) {
-        ++changed;
-        OP << "\t [CHANGED]\n";
-      } else
-        OP << "\n";
+  unsigned stage = 0;
+  bool more = true;
+  while (more) {
+    ++stage;
+    beginStage(stage);
+
+    unsigned iter = 0, changed = 1;
+    while (changed) {
+      ++iter;
+      changed = 0;
+      unsigned counter_modules = 0;
+      unsigned total_modules = modules.size();
+      for (i = modules.begin(), e = modules.end(); i != e; ++i) {
+        OP << "[" << ID << " / " << stage << "." << iter << "] ";
+        OP << "[" << ++counter_modules << " / " << total_modules << "] ";
+        OP << "[" << i->second << "]\n";
+
+        bool ret = doModulePass(i->first);
+        if (ret) {
+          ++changed;
+          OP << "\t [CHANGED]\n";
+        } else
+          OP << "\n";
+      }
+      OP << "[" << ID << "] Updated in " << changed << " modules.\n";
     }
-    OP << "[" << ID << "] Updated in " << changed << " modules.\n";
+
+    more = endStage(stage);
   }
 
   OP << "[" << ID << "] Postprocessing ...\n";
@@ -107,14 +272,539 @@ void IterativeModulePass::run(ModuleList &modules) {
   OP << "[" << ID << "] Done!\n\n";
 }
 
+bool HasModuleSummary(const string &BCFile) {
+
+	auto Buf = MemoryBuffer::getFile(BCFile);
+	if (!Buf)
+		return false;
+	Expected<BitcodeLTOInfo> LTOInfo = getBitcodeLTOInfo(**Buf);
+	if (!LTOInfo) {
+		consumeError(LTOInfo.takeError());
+		return false;
+	}
+	return LTOInfo->HasSummary;
+}
+
+// Parse a bitcode file into the given context. Parsing into separate
+// contexts is thread-safe.
+unique_ptr<Module> ParseModule(const string &BCFile, LLVMContext &LLVMCtx,
+		string &ErrMsg) {
+
+	SMDiagnostic Err;      // 此类的实例封装一个诊断报告，允许作为插入记号诊断程序打印到raw_ostream
+	unique_ptr<Module> M;
+	if (SummaryCallGraph)
+		// Function bodies are loaded later, see MaterializeFuncs()
+		M = getLazyIRFileModule(BCFile, Err, LLVMCtx);
+	else
+		M = parseIRFile(BCFile, Err, LLVMCtx);   // unique_ptr：智能指针，在适当时机自动释放堆内存空间
+                                                            // 如果给定文件包含位码图像，请为其返回一个模块。否则，请尝试将其解析为 LLVM 程序集并为其返回模块。
+
+	if (M == NULL) {
+		ErrMsg = "kanalyzer: error loading file '" + BCFile + "'\n";
+		return NULL;
+	}
+
+	// Without a summary, the call graph needs the function bodies
+	if (SummaryCallGraph && !HasModuleSummary(BCFile)) {
+		if (Error E = M->materializeAll()) {
+			ErrMsg = "kanalyzer: error loading file '" + BCFile + "': "
+				+ toString(move(E)) + "\n";
+			return NULL;
+		}
+	}
+
+	return M;
+}
+
+// Add a parsed module to the global context
+void RegisterModule(GlobalContext *GCtx, unique_ptr<Module> M,
+		const string &BCFile) {
+
+	// Same struct types of modules are renamed with suffixes in a
+	// shared context
+	if (SharedContext)
+		canonicalizeStructTypes(M.get());
+
+	Module *Module = M.release();          // 释放
+	StringRef MName = StringRef(strdup(BCFile.data()));  // strdup:返回一个指针,指向为复制字符串分配的空间; StringRef:表示一个固定不变的字符串的引用（包括一个字符数组的指针和长度）
+	GCtx->Modules.push_back(make_pair(Module, MName));  // make_pair:拼接，类似dict; push_back:函数将一个新的元素加到最后面
+	GCtx->ModuleMaps[Module] = BCFile;
+}
+
+// Load a bitcode file into the global context
+bool LoadModule(GlobalContext *GCtx, const string &BCFile) {
+
+	static LLVMContext *SharedLLVMCtx = new LLVMContext();
+	LLVMContext *LLVMCtx = SharedContext ? SharedLLVMCtx : new LLVMContext();    // 实例化一个LLVMContext对象，以存放一次LLVM编译的从属数据，使得LLVM线程安全。
+	string ErrMsg;
+	unique_ptr<Module> M = ParseModule(BCFile, *LLVMCtx, ErrMsg);
+	if (M == NULL) {
+		OP << ErrMsg;
+		return false;
+	}
+
+	RegisterModule(GCtx, move(M), BCFile);
+	return true;
+}
+
+// Ask the kernel to read the file ahead into the page cache
+void PrefetchFile(const string &BCFile) {
+
+	int fd = open(BCFile.c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+	posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+	close(fd);
+}
+
+// Load bitcode files on LoadThreads threads, overlapping reading and
+// parsing. Each thread prefetches the file LoadThreads ahead of the
+// one it parses, and parses into its own context. Parsed modules are
+// registered in the order of files, and parsing runs at most a window
+// of files ahead of registration.
+void LoadModulesPipelined(GlobalContext *GCtx, const vector<string> &BCFiles) {
+
+	size_t NumFiles = BCFiles.size();
+	size_t Window = 2 * LoadThreads;
+	vector<unique_ptr<Module>> Parsed(NumFiles);
+	vector<string> Errors(NumFiles);
+	vector<bool> Done(NumFiles, false);
+	size_t Next = 0, Registered = 0;
+	mutex Lock;
+	condition_variable Cond;
+
+	auto parseFiles = [&]() {
+		while (true) {
+			size_t i;
+			{
+				unique_lock<mutex> Guard(Lock);
+				Cond.wait(Guard, [&] {
+						return Next >= NumFiles || Next < Registered + Window; });
+				if (Next >= NumFiles)
+					return;
+				i = Next++;
+			}
+			if (i + LoadThreads < NumFiles)
+				PrefetchFile(BCFiles[i + LoadThreads]);
+
+			string ErrMsg;
+			unique_ptr<Module> M = ParseModule(BCFiles[i],
+					*new LLVMContext(), ErrMsg);
+			{
+				lock_guard<mutex> Guard(Lock);
+				Parsed[i] = move(M);
+				Errors[i] = ErrMsg;
+				Done[i] = true;
+			}
+			Cond.notify_all();
+		}
+	};
+
+	for (size_t i = 0; i < min<size_t>(LoadThreads, NumFiles); ++i)
+		PrefetchFile(BCFiles[i]);
+	vector<thread> Loaders;
+	for (unsigned i = 0; i < LoadThreads; ++i)
+		Loaders.emplace_back(parseFiles);
+
+	for (size_t i = 0; i < NumFiles; ++i) {
+		unique_ptr<Module> M;
+		{
+			unique_lock<mutex> Guard(Lock);
+			Cond.wait(Guard, [&] { return Done[i]; });
+			M = move(Parsed[i]);
+			++Registered;
+		}
+		Cond.notify_all();
+
+		if (M)
+			RegisterModule(GCtx, move(M), BCFiles[i]);
+		else
+			OP << Errors[i];
+	}
+
+	for (thread &L : Loaders)
+		L.join();
+}
+
+// Load the modules defining the external functions called in the
+// loaded modules, recursively up to IndexDepth levels of callees
+void LoadModulesOnDemand(GlobalContext *GCtx, BitcodeIndex &Index) {
+
+	set<string> LoadedFiles;
+	for (auto M : GCtx->Modules)
+		LoadedFiles.insert(M.second.str());
+
+	size_t Begin = 0;
+	for (unsigned D = 0; D < IndexDepth; ++D) {
+		set<string> BCFiles;
+		size_t End = GCtx->Modules.size();
+		for (size_t i = Begin; i < End; ++i) {
+			for (Function &F : *GCtx->Modules[i].first) {
+				if (!F.isDeclaration() || F.isIntrinsic())
+					continue;
+				StringRef BCFile = Index.lookupDef(F.getName());
+				if (!BCFile.empty())
+					BCFiles.insert(BCFile.str());
+			}
+		}
+		// Potential targets of indirect calls
+		if (IndexIndirect && D == 0)
+			Index.getAddrTakenFiles(BCFiles);
+
+		unsigned NumLoaded = 0;
+		for (auto &BCFile : BCFiles) {
+			if (!LoadedFiles.insert(BCFile).second)
+				continue;
+			NumLoaded += LoadModule(GCtx, BCFile);
+		}
+		OP << "Loaded " << NumLoaded << " module(s) of level-" << D + 1
+			<< " callees on demand\n";
+		if (!NumLoaded)
+			break;
+		Begin = End;
+	}
+}
+
+// Load ad-hoc modeled functions from configs/extra-funcs, if any.
+// Each line adds a function or overrides its argument numbers:
+//   err <name>
+//   copy <name> <src_arg#> <dst_arg#> <size_arg#>
+//   fetch <name> <dst_arg#> <src_arg#>
+//   skip <name>
+static void LoadExtraFuncs(FuncRoleTable &ModeledFuncs) {
+
+	string exepath = sys::fs::getMainExecutable(NULL, NULL);
+	string exedir = exepath.substr(0, exepath.find_last_of('/'));
+	ifstream extrafile(exedir + "/configs/extra-funcs");
+	if (!extrafile.is_open())
+		return;
+
+	string line, kind, name;
+	while (getline(extrafile, line)) {
+		istringstream iss(line);
+		if (!(iss >> kind >> name) || kind[0] == '#')
+			continue;
+
+		int a0 = -1, a1 = -1, a2 = -1;
+		if (kind == "err") {
+			ModeledFuncs.add(name, FR_ERR_HANDLE);
+		}
+		else if (kind == "skip") {
+			ModeledFuncs.add(name, FR_SKIP);
+		}
+		else if (kind == "copy" && (iss >> a0 >> a1 >> a2)) {
+			FuncRoleInfo &FRI = ModeledFuncs.add(name, FR_COPY);
+			FRI.CopySrc = a0;
+			FRI.CopyDst = a1;
+			FRI.CopySize = a2;
+		}
+		else if (kind == "fetch" && (iss >> a0 >> a1)) {
+			FuncRoleInfo &FRI = ModeledFuncs.add(name, FR_DATA_FETCH);
+			FRI.FetchDst = a0;
+			FRI.FetchSrc = a1;
+		}
+		else
+			OP << "Ignoring malformed line in extra-funcs: " << line << "\n";
+	}
+	extrafile.close();
+}
+
+// Load the functions to focus on from configs/test-funcs. Each line
+// names a function; text after "//" is a comment.
+static void LoadTestFuncs(set<string> &TestFuncs) {
+
+	string exepath = sys::fs::getMainExecutable(NULL, NULL);
+	string exedir = exepath.substr(0, exepath.find_last_of('/'));
+	ifstream testfile(exedir + "/configs/test-funcs");
+	if (!testfile.is_open()) {
+		OP << "Cannot open configs/test-funcs\n";
+		return;
+	}
+
+	string line, name;
+	while (getline(testfile, line)) {
+		istringstream iss(line.substr(0, line.find("//")));
+		if (iss >> name)
+			TestFuncs.insert(name);
+	}
+	testfile.close();
+}
+
+// Setup functions that handle errors, copy/move/cast values, fetch
+// data from the external, and that are not interesting to analyze
+static void SetModeledFuncs(FuncRoleTable &ModeledFuncs) {
+
+	for (auto FN : GenErrorHandleFuncs)
+		ModeledFuncs.add(FN, FR_ERR_HANDLE);
+	for (auto FN : ErrorHandleFN)
+		ModeledFuncs.add(FN, FR_ERR_HANDLE);
+
+	// <src, dst, size>
+	for (auto &CF : GenCopyFuncs) {
+		FuncRoleInfo &FRI = ModeledFuncs.add(CF.Name, FR_COPY);
+		FRI.CopySrc = CF.Src;
+		FRI.CopyDst = CF.Dst;
+		FRI.CopySize = CF.Size;
+	}
+
+	// <dst_arg#, source_arg#>
+	for (auto &DF : GenDataFetchFuncs) {
+		FuncRoleInfo &FRI = ModeledFuncs.add(DF.Name, FR_DATA_FETCH);
+		FRI.FetchDst = DF.Dst;
+		FRI.FetchSrc = DF.Src;
+	}
+
+	for (auto FN : GenSkipFuncs)
+		ModeledFuncs.add(FN, FR_SKIP);
+
+	LoadExtraFuncs(ModeledFuncs);
+	ModeledFuncs.build();
+}
+
 void LoadStaticData(GlobalContext *GCtx) {
 
-	// Load error-handling functions
-	SetErrorHandleFuncs(GCtx->ErrorHandleFuncs);  //把config下err-funcs文件中的函数名+其它几个函数名 赋给ErrorHandleFuncs
-	// load functions that copy/move values
-	SetCopyFuncs(GCtx->CopyFuncs);               // 类CopyFuncs["memcpy"] = make_tuple(1, 0, 2);
-	// load data-fetch functions
-	SetDataFetchFuncs(GCtx->DataFetchFuncs);     // 类DataFetchFuncs["copy_from_user"] = make_pair(0, 1);
+	// Load error-handling, copy and data-fetch functions, compiled in
+	// from configs/ at build time
+	SetModeledFuncs(GCtx->ModeledFuncs);
+
+	// Tag all functions with their roles, so that analyses need not
+	// compare names per call
+	for (auto M : GCtx->Modules) {
+		for (Function &F : *M.first)
+			GCtx->ModeledFuncs.tagFunction(&F);
+	}
+}
+
+// Whether the type is, or is an array of, a struct of operations
+// invoked from user space
+static bool isEntryOpsType(Type *Ty) {
+
+	while (ArrayType *ATy = dyn_cast<ArrayType>(Ty))
+		Ty = ATy->getElementType();
+	StructType *STy = dyn_cast<StructType>(Ty);
+	if (!STy || !STy->hasName())
+		return false;
+
+	StringRef Name = STy->getName();
+	if (!Name.consume_front("struct."))
+		return false;
+	Name = Name.split('.').first;
+	for (auto TN : EntryOpsTypes) {
+		if (Name == TN)
+			return true;
+	}
+	return false;
+}
+
+// Collect the functions in the initializer of a global
+static void collectInitFuncs(Constant *C, set<Function *> &Funcs) {
+
+	if (Function *F = dyn_cast<Function>(C)) {
+		Funcs.insert(F);
+		return;
+	}
+	if (!isa<ConstantAggregate>(C) && !isa<ConstantExpr>(C))
+		return;
+	for (Use &U : C->operands())
+		collectInitFuncs(cast<Constant>(U.get()), Funcs);
+}
+
+// The definition of the function used in the call graph
+static Function *getUnifiedFunc(GlobalContext *GCtx, Function *F) {
+
+	if (F->isDeclaration()) {
+		auto It = GCtx->GlobalFuncs.find(F->getName().str());
+		if (It != GCtx->GlobalFuncs.end() && It->second)
+			F = It->second;
+	}
+	Function *UF = GCtx->UnifiedFuncMap.lookup(funcHash(F));
+	return UF ? UF : F;
+}
+
+// Mark the functions reachable in the call graph from the entry
+// points of user space: syscalls, handlers in structs of operations,
+// either initialized or stored, and the callers of data-fetch
+// functions. The later passes analyze the marked functions only.
+void SetReachableFuncs(GlobalContext *GCtx) {
+
+	set<Function *> Entries;
+	for (Function *F : GCtx->UnifiedFuncSet) {
+		StringRef FName = F->getName();
+		if (FName.startswith("sys_") || FName.startswith("SyS_"))
+			Entries.insert(F);
+	}
+
+	for (auto M : GCtx->Modules) {
+		for (GlobalVariable &GV : M.first->globals()) {
+			if (!GV.hasInitializer() || !isEntryOpsType(GV.getValueType()))
+				continue;
+			set<Function *> Handlers;
+			collectInitFuncs(GV.getInitializer(), Handlers);
+			for (Function *HF : Handlers)
+				Entries.insert(getUnifiedFunc(GCtx, HF));
+		}
+
+		for (Function &F : *M.first) {
+			if (!GCtx->UnifiedFuncSet.count(&F))
+				continue;
+			const FuncFacts &FF = GCtx->getFuncFacts(&F);
+			for (const MemFact &MF : FF.MemAccesses) {
+				if (MF.Kind != MA_STORE)
+					continue;
+				StoreInst *SI = cast<StoreInst>(MF.I);
+				Function *HF = dyn_cast<Function>(
+						SI->getValueOperand()->stripPointerCasts());
+				GEPOperator *GEP = dyn_cast<GEPOperator>(SI->getPointerOperand());
+				if (HF && GEP && isEntryOpsType(GEP->getSourceElementType()))
+					Entries.insert(getUnifiedFunc(GCtx, HF));
+			}
+			for (const CallFact &Call : FF.Calls) {
+				if (Call.Callee && (GCtx->ModeledFuncs.getRoles(Call.Callee)
+							& FR_DATA_FETCH))
+					Entries.insert(&F);
+			}
+		}
+	}
+	for (auto &SC : GCtx->SummaryCallers) {
+		if (GCtx->ModeledFuncs.getRoles(SC.first) & FR_DATA_FETCH)
+			Entries.insert(SC.second.begin(), SC.second.end());
+	}
+
+	// Number the functions for the bitmap
+	GCtx->FuncIDs.clear();
+	for (Function *F : GCtx->UnifiedFuncSet)
+		GCtx->FuncIDs.insert(make_pair(F, GCtx->FuncIDs.size()));
+	for (Function *F : Entries)
+		GCtx->FuncIDs.insert(make_pair(F, GCtx->FuncIDs.size()));
+	BitVector Reachable(GCtx->FuncIDs.size());
+
+	list<Function *> EF(Entries.begin(), Entries.end());
+	unsigned NumReachable = 0;
+	while (!EF.empty()) {
+		Function *F = EF.front();
+		EF.pop_front();
+		auto It = GCtx->FuncIDs.find(F);
+		if (It == GCtx->FuncIDs.end() || Reachable.test(It->second))
+			continue;
+		Reachable.set(It->second);
+		++NumReachable;
+
+		// Both from call sites and from module summaries
+		for (const CallFact &Call : GCtx->getFuncFacts(F).Calls) {
+			auto CI = GCtx->Callees.find(Call.CI);
+			if (CI != GCtx->Callees.end())
+				EF.insert(EF.end(), CI->second.begin(), CI->second.end());
+		}
+		auto SI = GCtx->SummaryCallees.find(F);
+		if (SI != GCtx->SummaryCallees.end())
+			EF.insert(EF.end(), SI->second.begin(), SI->second.end());
+	}
+
+	OP << "Reachable from " << Entries.size() << " entry points: "
+		<< NumReachable << " / " << GCtx->UnifiedFuncSet.size()
+		<< " functions\n";
+	GCtx->ReachableFuncs = move(Reachable);
+}
+
+// Collect the functions to analyze in focus mode: the focused
+// functions, their callers and callees up to FocusDepth, and the
+// functions calling the same callees, which share their sources and
+// uses and are thus needed for the statistics. Only modules
+// containing such functions are kept for the later passes.
+void SetFocusFuncs(GlobalContext *GCtx) {
+
+	set<string> FocusNames(FocusFuncNames.begin(), FocusFuncNames.end());
+	if (FocusTestFuncs)
+		LoadTestFuncs(FocusNames);
+	if (FocusNames.empty())
+		return;
+
+	map<Function *, unsigned> Depth;
+	list<Function *> EF;
+	for (Function *F : GCtx->UnifiedFuncSet) {
+		if (!F->isDeclaration() && FocusNames.count(F->getName().str())) {
+			Depth[F] = 0;
+			EF.push_back(F);
+		}
+	}
+	if (EF.empty()) {
+		OP << "None of the focused functions is found, analyzing all\n";
+		return;
+	}
+
+	set<Function *> PeerFuncs;
+	while (!EF.empty()) {
+		Function *F = EF.front();
+		EF.pop_front();
+		unsigned D = Depth[F];
+		GCtx->FocusFuncs.insert(F);
+
+		// Both from call sites and from module summaries
+		vector<Function *> NextFuncs;
+		FuncSet CalleeFuncs = GCtx->SummaryCallees[F];
+		for (CallInst *CI : GCtx->Callers[F])
+			NextFuncs.push_back(CI->getFunction());
+		for (Function *CF : GCtx->SummaryCallers[F])
+			NextFuncs.push_back(CF);
+		for (const CallFact &Call : GCtx->getFuncFacts(F).Calls)
+			CalleeFuncs.insert(GCtx->Callees[Call.CI].begin(),
+					GCtx->Callees[Call.CI].end());
+		for (Function *CF : CalleeFuncs) {
+			NextFuncs.push_back(CF);
+			if (D == 0 && !(GCtx->ModeledFuncs.getRoles(CF) & FR_SKIP)) {
+				for (CallInst *PCI : GCtx->Callers[CF])
+					PeerFuncs.insert(PCI->getFunction());
+				for (Function *PF : GCtx->SummaryCallers[CF])
+					PeerFuncs.insert(PF);
+			}
+		}
+
+		if (D >= FocusDepth)
+			continue;
+		for (Function *NF : NextFuncs) {
+			if (NF->isDeclaration() || Depth.count(NF))
+				continue;
+			Depth[NF] = D + 1;
+			EF.push_back(NF);
+		}
+	}
+	GCtx->FocusFuncs.insert(PeerFuncs.begin(), PeerFuncs.end());
+
+	ModuleList FocusModules;
+	for (auto M : GCtx->Modules) {
+		for (Function &F : *M.first) {
+			if (GCtx->FocusFuncs.count(&F)) {
+				FocusModules.push_back(M);
+				break;
+			}
+		}
+	}
+	OP << "Focus on " << GCtx->FocusFuncs.size() << " functions in "
+		<< FocusModules.size() << " / " << GCtx->Modules.size() << " modules\n";
+	GCtx->Modules = FocusModules;
+}
+
+// Load the bodies of the functions to analyze, which are not loaded
+// when the call graph is built from module summaries, and map their
+// call sites to callees
+void MaterializeFuncs(GlobalContext *GCtx, CallGraphPass &CGPass) {
+
+	unsigned NumFuncs = 0;
+	for (auto M : GCtx->Modules) {
+		for (Function &F : *M.first) {
+			if (!F.isMaterializable() || !GCtx->isFocused(&F)
+					|| !GCtx->isReachable(&F))
+				continue;
+			if (Error E = F.materialize()) {
+				consumeError(move(E));
+				continue;
+			}
+			++NumFuncs;
+			if (GCtx->UnifiedFuncSet.count(&F))
+				CGPass.collectCallees(&F);
+		}
+	}
+	OP << "Materialized " << NumFuncs << " functions\n";
 }
 
 void ProcessResults(GlobalContext *GCtx) {
@@ -136,27 +826,52 @@ int main(int argc, char **argv) {
 	llvm_shutdown_obj Y;  // Call llvm_shutdown() on exit.
 
 	cl::ParseCommandLineOptions(argc, argv, "global analysis\n");  // 命令行接口
-	SMDiagnostic Err;      // 此类的实例封装一个诊断报告，允许作为插入记号诊断程序打印到raw_ostream
 
-	// Loading modules
-	OP << "Total " << InputFilenames.size() << " file(s)\n";
+	GlobalCtx.NumThreads = NumThreads;
+	if (Deadline)
+		GlobalCtx.Deadline = chrono::steady_clock::now()
+			+ chrono::seconds(Deadline);
+
+	// Re-rank saved statistics only
+	if (!RerankFile.empty()) {
+		if (!MissingChecksPass::rerankResults(RerankFile))
+			ERR("Cannot read stats file " << RerankFile << "\n");
+		return 0;
+	}
 
-	for (unsigned i = 0; i < InputFilenames.size(); ++i) {
+	if (InputFilenames.empty())
+		ERR("No input bitcode files\n");
+
+	// Index the functions of bitcode files only
+	if (!BuildIndexFile.empty()) {
+		BitcodeIndex Index;
+		Index.build(InputFilenames);
+		if (!Index.write(BuildIndexFile))
+			ERR("Cannot write index file " << BuildIndexFile << "\n");
+		OP << "Indexed " << Index.size() << " functions\n";
+		return 0;
+	}
 
-		LLVMContext *LLVMCtx = new LLVMContext();    // 实例化一个LLVMContext对象，以存放一次LLVM编译的从属数据，使得LLVM线程安全。
-		unique_ptr<Module> M = parseIRFile(InputFilenames[i], Err, *LLVMCtx);   // unique_ptr：智能指针，在适当时机自动释放堆内存空间
-                                                            // 如果给定文件包含位码图像，请为其返回一个模块。否则，请尝试将其解析为 LLVM 程序集并为其返回模块。
+	// Loading modules
+	OP << "Total " << InputFilenames.size() << " file(s)\n";
 
-		if (M == NULL) {
-			OP << argv[0] << ": error loading file '"
-				<< InputFilenames[i] << "'\n";
-			continue;
+	// Modules of a shared context cannot be parsed in parallel
+	if (LoadThreads > 1 && !SharedContext)
+		LoadModulesPipelined(&GlobalCtx, InputFilenames);
+	else {
+		for (unsigned i = 0; i < InputFilenames.size(); ++i) {
+			if (i + 1 < InputFilenames.size())
+				PrefetchFile(InputFilenames[i + 1]);
+			LoadModule(&GlobalCtx, InputFilenames[i]);
 		}
+	}
 
-		Module *Module = M.release();          // 释放
-		StringRef MName = StringRef(strdup(InputFilenames[i].data()));  // strdup:返回一个指针,指向为复制字符串分配的空间; StringRef:表示一个固定不变的字符串的引用（包括一个字符数组的指针和长度）
-		GlobalCtx.Modules.push_back(make_pair(Module, MName));  // make_pair:拼接，类似dict; push_back:函数将一个新的元素加到最后面
-		GlobalCtx.ModuleMaps[Module] = InputFilenames[i];  
+	// Load the modules of called functions, if indexed
+	if (!IndexFile.empty()) {
+		BitcodeIndex Index;
+		if (!Index.read(IndexFile))
+			ERR("Cannot read index file " << IndexFile << "\n");
+		LoadModulesOnDemand(&GlobalCtx, Index);
 	}
 
 	// Main workflow
@@ -166,12 +881,37 @@ int main(int argc, char **argv) {
 	TypeInitializerPass TIPass(&GlobalCtx);   // 1、TypeValueMap,将每个没有类型名称的全局struct映射到其值名称 
 	                                          // 2、VnameToTypenameMap,将全局变量名称映射到其struct类型名称
 		                                  // 3、根据上面两个，先赋给GlobalCtx的GlobalTypes，然后给TypeToTNameMap
+
+	// Scan the instructions of all functions once, serving the
+	// handlers of the passes and extracting the facts of functions
+	InstScanner Scanner(&GlobalCtx);
+	TIPass.registerHandlers(Scanner);
+	for (auto M : GlobalCtx.Modules)
+		Scanner.scan(M.first);
+
 	TIPass.run(GlobalCtx.Modules);            // 运行，下载了结果。没找到有用信息
 	TIPass.BuildTypeStructMap();              // 根据上面两个，先赋给GlobalCtx的GlobalTypes，然后给TypeToTNameMap
 
+	// Functions of the core kernel are resolved from its summary
+	if (!CoreSummaryFile.empty()
+			&& !MissingChecksPass::readCoreSummary(CoreSummaryFile, &GlobalCtx))
+		ERR("Cannot read core summary " << CoreSummaryFile << "\n");
+
 	// Build global callgraph.   1、两层类分析+类型逃逸、循环展开、指针/别名分析
 	CallGraphPass CGPass(&GlobalCtx);
 	CGPass.run(GlobalCtx.Modules);
+	if (SummaryCallGraph)
+		CGPass.buildFromSummaries(GlobalCtx.Modules);
+
+	// Narrow the analysis to the functions reachable from user space
+	if (EntryReach)
+		SetReachableFuncs(&GlobalCtx);
+
+	// Narrow the analysis to the focused functions, if any
+	SetFocusFuncs(&GlobalCtx);
+
+	if (SummaryCallGraph && (SecurityChecks || MissingChecks))
+		MaterializeFuncs(&GlobalCtx, CGPass);
 
 	// Identify sanity checks    2、找到错误返回、错误处理的块，把边放入集合中。然后找到满足if限定条件的安全检查语句。
 	if (SecurityChecks) {
@@ -183,14 +923,31 @@ int main(int argc, char **argv) {
 	if (MissingChecks) {
 		// Pointer analysis
 		PointerAnalysisPass PAPass(&GlobalCtx);
-		PAPass.run(GlobalCtx.Modules);
-
+		PointerAnalysisCache PACache(&GlobalCtx, &PAPass, PACacheSize);
+		if (PACacheSize)
+			GlobalCtx.PACache = &PACache;
+		else
+			PAPass.run(GlobalCtx.Modules);
+
+		// Stage 1 of missing-check detection counts the checks of
+		// each function as soon as they are identified
+		MissingChecksPass MCPass(&GlobalCtx);   //这里才是找src、use，构建对等片？
 		SecurityChecksPass SCPass(&GlobalCtx);
+		SCPass.setChecksHandler([&MCPass](Function *F) {
+				MCPass.countChecks(F); });
+		MCPass.setChecksCounted();
+		// Sampled pruning would drop keys from a core summary
+		if (!SaveCoreSummaryFile.empty())
+			MCPass.setKeepAll();
+		else if (SampleStage2)
+			MCPass.setSampledStage2();
 		SCPass.run(GlobalCtx.Modules);
 
-		MissingChecksPass MCPass(&GlobalCtx);   //这里才是找src、use，构建对等片？
 		MCPass.run(GlobalCtx.Modules);   
-		MCPass.processResults();     //构建交叉约束？
+		if (!SaveCoreSummaryFile.empty()
+				&& !MCPass.writeCoreSummary(SaveCoreSummaryFile))
+			ERR("Cannot write core summary " << SaveCoreSummaryFile << "\n");
+		MCPass.processResults(MCStatsFile);     //构建交叉约束？
 	}
 
 	// Print final results
@@ -4,6 +4,7 @@
 #include <llvm/IR/DebugInfo.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/ADT/BitVector.h>
 #include <llvm/ADT/DenseMap.h>
 #include <llvm/ADT/SmallPtrSet.h>
 #include <llvm/ADT/StringExtras.h>
@@ -19,8 +20,11 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <atomic>
+#include <mutex>
 
 #include "Common.h"
+#include "FuncFacts.h"
 
 
 // 
@@ -39,23 +43,35 @@ typedef DenseMap<CallInst *, FuncSet> CalleeMap;
 // Pointer analysis types.
 typedef DenseMap<Value *, SmallPtrSet<Value *, 16>> PointerAnalysisMap;
 typedef unordered_map<Function *, PointerAnalysisMap> FuncPointerAnalysisMap;
-typedef unordered_map<Function *, AAResults *> FuncAAResultsMap;
 typedef map<Type*, string> TypeNameMap;
 
+class PointerAnalysisCache;
+
 struct GlobalContext {
 
 	GlobalContext() {
 		// Initialize statistucs.
 		NumSecurityChecks = 0;
 		NumCondStatements = 0;
+		NumThreads = 1;
+		PACache = NULL;
+		Deadline = chrono::steady_clock::time_point::max();
+		ChecksDeadline = chrono::steady_clock::time_point::max();
 	}
 
 	unsigned NumSecurityChecks;
-	unsigned NumCondStatements;
+	// Counted by functions analyzed in parallel
+	atomic<unsigned> NumCondStatements;
+
+	// Threads analyzing functions in parallel
+	unsigned NumThreads;
 	
 	// Map global types to type_name
 	TypeNameMap GlobalTypes;
 
+	// Canonical IDs of types across modules
+	TypeIDTable TypeIDs;
+
 	// Map global function name to function.
 	NameFuncMap GlobalFuncs;
 
@@ -68,6 +84,11 @@ struct GlobalContext {
 	// Map a function to all potential caller instructions.
 	CallerMap Callers;
 
+	// Function-level call graph from module summaries, covering the
+	// functions whose bodies are not loaded.
+	DenseMap<Function *, FuncSet> SummaryCallees;
+	DenseMap<Function *, FuncSet> SummaryCallers;
+
 	// Indirect call instructions.
 	std::vector<CallInst *>IndirectCallInsts;
 	
@@ -79,15 +100,18 @@ struct GlobalContext {
 	// Map function signature to functions
 	DenseMap<size_t, FuncSet>sigFuncsMap;
 
+	// Functions of the core kernel with their numbers of call sites,
+	// when analyzing a driver against a core summary, and the
+	// declarations representing them in the driver
+	StringMap<unsigned> CoreCallSites;
+	StringMap<Function *> CoreFuncs;
+
 	// Modules.
 	ModuleList Modules;
 	ModuleNameMap ModuleMaps;
 	set<string> InvolvedModules;
 
 	// SecurityChecksPass
-	// Functions handling errors
-	set<string> ErrorHandleFuncs;
-	map<string, tuple<int8_t, int8_t, int8_t>> CopyFuncs;
 
 	// Identified sanity checks
 	DenseMap<Function *, set<SecurityCheck>> SecurityCheckSets;
@@ -96,15 +120,73 @@ struct GlobalContext {
 
 	// Pointer analysis results.
     FuncPointerAnalysisMap FuncPAResults;
-    FuncAAResultsMap FuncAAResults;
+	// Computes pointer analysis results on demand, if set
+	PointerAnalysisCache *PACache;
+
+	// Pointer analysis results of the function. With PACache, the
+	// results are valid only until the next call, which may evict
+	// them, so they must not be kept across calls.
+	PointerAnalysisMap &getPAResults(Function *F);
+
+	// Facts of functions, extracted on the first use
+	DenseMap<Function *, unique_ptr<FuncFacts>> FuncFactsMap;
+	mutex FuncFactsLock;
+
+	const FuncFacts &getFuncFacts(Function *F);
+
+	// Functions handling errors, copying values, and fetching data
+	// from the external, compiled for fast lookups
+	FuncRoleTable ModeledFuncs;
+
+	// Functions to analyze in focus mode; empty means all
+	set<Function *> FocusFuncs;
+
+	bool isFocused(Function *F) {
+		return FocusFuncs.empty() || FocusFuncs.count(F);
+	}
+
+	// Functions reachable from entry points in the call graph, as
+	// a bitmap of function IDs; empty means all
+	DenseMap<Function *, unsigned> FuncIDs;
+	BitVector ReachableFuncs;
 
-	map<string, pair<int8_t, int8_t>> DataFetchFuncs;
+	bool isReachable(Function *F) {
+		if (ReachableFuncs.empty())
+			return true;
+		auto It = FuncIDs.find(F);
+		return It != FuncIDs.end() && ReachableFuncs.test(It->second);
+	}
+
+	// Wall-clock deadline of the analysis, if any
+	chrono::steady_clock::time_point Deadline;
+
+	bool hasDeadline() {
+		return Deadline != chrono::steady_clock::time_point::max();
+	}
+	bool isPastDeadline() {
+		return chrono::steady_clock::now() > Deadline;
+	}
+
+	// Earlier deadline of identifying and counting checks, leaving
+	// time to count unchecks over the checks found
+	chrono::steady_clock::time_point ChecksDeadline;
+
+	bool isPastChecksDeadline() {
+		return chrono::steady_clock::now() > ChecksDeadline;
+	}
 };
 
+//
+// Module pass run in stages. In each stage, doModulePass() runs on all
+// modules until none of them changes. The stages are separated by
+// barriers: beginStage() and endStage() run when no module is in the
+// middle of the stage, and endStage() tells if another stage follows.
+//
 class IterativeModulePass {
 protected:
 	GlobalContext *Ctx;
 	const char * ID;
+
 public:
 	IterativeModulePass(GlobalContext *Ctx_, const char *ID_)
 		: Ctx(Ctx_), ID(ID_) { }
@@ -117,10 +199,16 @@ public:
 	virtual bool doFinalization(llvm::Module *M)
 		{ return true; }
 
-	// Iterative pass.
+	// Iterative pass. Returns true if the results of the module
+	// changed, so that the modules are run again.
 	virtual bool doModulePass(llvm::Module *M)
 		{ return false; }
 
+	// Barriers before and after each stage, counted from 1
+	virtual void beginStage(unsigned Stage) { }
+	virtual bool endStage(unsigned Stage)
+		{ return false; }
+
 	virtual void run(ModuleList &modules);
 };
 
@@ -0,0 +1,200 @@
+//===-- BitcodeIndex.cc - Index symbols of bitcode files----------===//
+//
+// This file implements an on-disk index that maps functions to the
+// bitcode files defining them. Defined functions are read from the
+// symbol tables of bitcode files and address-taken ones from their
+// module summaries, so no IR is parsed unless a file lacks either.
+//
+//===-----------------------------------------------------------===//
+
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/ModuleSummaryIndex.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Object/IRSymtab.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+
+#include <iomanip>
+
+#include "BitcodeIndex.h"
+
+string BitcodeIndex::normalizeName(StringRef FName) {
+	if (FName.startswith("SyS_"))
+		return "sys_" + FName.str().substr(4);
+	return FName.str();
+}
+
+void BitcodeIndex::build(const vector<string> &BCFiles) {
+
+	for (auto &BCFile : BCFiles) {
+		auto Buf = MemoryBuffer::getFile(BCFile);
+		if (!Buf) {
+			OP << "Cannot index file '" << BCFile << "'\n";
+			continue;
+		}
+
+		unsigned FileNo = Files.size();
+		Files.push_back(BCFile);
+
+		bool HasSymtab = indexSymtab(**Buf, FileNo);
+		if (HasSymtab && indexSummary(**Buf, FileNo))
+			continue;
+		// Files without a symbol table, e.g., without a target
+		// triple, or without a summary fall back to their IR
+		if (!indexModule(**Buf, FileNo, !HasSymtab)) {
+			OP << "Cannot index file '" << BCFile << "'\n";
+			if (!HasSymtab)
+				Files.pop_back();
+		}
+	}
+}
+
+// Index the strong definitions of global functions from the symbol
+// table of the bitcode file
+bool BitcodeIndex::indexSymtab(MemoryBufferRef Buf, unsigned FileNo) {
+
+	Expected<BitcodeFileContents> BFC = getBitcodeFileContents(Buf);
+	Expected<irsymtab::FileContents> FC = BFC
+		? irsymtab::readBitcode(*BFC)
+		: BFC.takeError();
+	if (!FC) {
+		consumeError(FC.takeError());
+		return false;
+	}
+
+	for (auto Sym : FC->TheReader.symbols()) {
+		if (!Sym.isUndefined() && Sym.isExecutable() && Sym.isGlobal()
+				&& !Sym.isWeak() && !Sym.getIRName().empty())
+			DefFuncs[normalizeName(Sym.getIRName())] = FileNo;
+	}
+	return true;
+}
+
+// Index the functions defined in the file and referenced other than
+// by calls, in bodies and in global initializers, e.g., ops tables,
+// from the module summary of the file
+bool BitcodeIndex::indexSummary(MemoryBufferRef Buf, unsigned FileNo) {
+
+	Expected<BitcodeLTOInfo> LTOInfo = getBitcodeLTOInfo(Buf);
+	if (!LTOInfo || !LTOInfo->HasSummary) {
+		consumeError(LTOInfo.takeError());
+		return false;
+	}
+	Expected<unique_ptr<ModuleSummaryIndex>> Index =
+		getModuleSummaryIndex(Buf);
+	if (!Index) {
+		consumeError(Index.takeError());
+		return false;
+	}
+
+	DenseSet<GlobalValue::GUID> Refs;
+	for (auto &GVS : **Index) {
+		for (auto &S : GVS.second.SummaryList) {
+			for (ValueInfo Ref : S->refs())
+				Refs.insert(Ref.getGUID());
+		}
+	}
+	for (auto &GVS : **Index) {
+		if (!Refs.count(GVS.first))
+			continue;
+		for (auto &S : GVS.second.SummaryList) {
+			if (isa<FunctionSummary>(S.get())) {
+				ValueInfo VI = (*Index)->getValueInfo(GVS.first);
+				AddrTakenFuncs.push_back(make_pair(VI.name().str(), FileNo));
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+// Load the module lazily, i.e., without function bodies, so only the
+// addresses taken in global initializers are visible
+bool BitcodeIndex::indexModule(MemoryBufferRef Buf, unsigned FileNo,
+		bool IndexDefs) {
+
+	LLVMContext LLVMCtx;
+	SMDiagnostic Err;
+	unique_ptr<Module> M = getLazyIRModule(
+			MemoryBuffer::getMemBuffer(Buf, false), Err, LLVMCtx);
+	if (!M)
+		return false;
+
+	for (Function &F : *M) {
+		if (F.isDeclaration())
+			continue;
+
+		if (IndexDefs && F.hasExternalLinkage())
+			DefFuncs[normalizeName(F.getName())] = FileNo;
+
+		if (F.hasAddressTaken())
+			AddrTakenFuncs.push_back(make_pair(F.getName().str(), FileNo));
+	}
+	return true;
+}
+
+bool BitcodeIndex::write(const string &IndexFile) {
+
+	ofstream indexfile(IndexFile);
+	if (!indexfile.is_open())
+		return false;
+
+	// Paths are quoted, as they may contain spaces
+	for (auto &BCFile : Files)
+		indexfile << "F " << quoted(BCFile) << "\n";
+	for (auto &DF : DefFuncs)
+		indexfile << "D " << DF.second << " " << DF.first().str() << "\n";
+	for (auto &AF : AddrTakenFuncs)
+		indexfile << "A " << AF.second << " " << AF.first << "\n";
+	indexfile.close();
+
+	return true;
+}
+
+bool BitcodeIndex::read(const string &IndexFile) {
+
+	ifstream indexfile(IndexFile);
+	if (!indexfile.is_open())
+		return false;
+
+	string line, kind, name;
+	unsigned FileNo;
+	while (getline(indexfile, line)) {
+		istringstream iss(line);
+		if (!(iss >> kind))
+			continue;
+
+		if (kind == "F") {
+			if (iss >> quoted(name))
+				Files.push_back(name);
+		}
+		else if ((kind == "D" || kind == "A")
+				&& (iss >> FileNo >> name) && FileNo < Files.size()) {
+			if (kind == "D")
+				DefFuncs[name] = FileNo;
+			else
+				AddrTakenFuncs.push_back(make_pair(name, FileNo));
+		}
+		else
+			OP << "Ignoring malformed line in index: " << line << "\n";
+	}
+	indexfile.close();
+
+	return true;
+}
+
+StringRef BitcodeIndex::lookupDef(StringRef FName) {
+
+	auto It = DefFuncs.find(normalizeName(FName));
+	if (It == DefFuncs.end())
+		return StringRef();
+
+	return Files[It->second];
+}
+
+void BitcodeIndex::getAddrTakenFiles(set<string> &BCFiles) {
+
+	for (auto &AF : AddrTakenFuncs)
+		BCFiles.insert(Files[AF.second]);
+}
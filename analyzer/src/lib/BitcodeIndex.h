@@ -0,0 +1,50 @@
+#ifndef BITCODE_INDEX_H
+#define BITCODE_INDEX_H
+
+#include "Analyzer.h"
+
+//
+// Index of the functions defined and address-taken in bitcode files.
+// It is built from the symbol tables and module summaries of the files,
+// without parsing their IR, and is saved to disk, so that an analysis
+// can load only the modules it needs on demand.
+//
+// On-disk format, one entry per line:
+//   F "<bitcode file>"
+//   D <file#> <defined function>
+//   A <file#> <address-taken function>
+//
+class BitcodeIndex {
+
+	public:
+		// Index the given bitcode files
+		void build(const vector<string> &BCFiles);
+
+		bool write(const string &IndexFile);
+		bool read(const string &IndexFile);
+
+		// Get the bitcode file defining the function, or an empty
+		// string if it is unknown
+		StringRef lookupDef(StringRef FName);
+
+		// Get the bitcode files that take addresses of functions
+		void getAddrTakenFiles(set<string> &BCFiles);
+
+		size_t size() { return DefFuncs.size(); }
+
+		// Names of syscalls are consistent with CallGraphPass
+		static string normalizeName(StringRef FName);
+
+	private:
+		bool indexSymtab(MemoryBufferRef Buf, unsigned FileNo);
+		bool indexSummary(MemoryBufferRef Buf, unsigned FileNo);
+		bool indexModule(MemoryBufferRef Buf, unsigned FileNo,
+				bool IndexDefs);
+
+		vector<string> Files;
+		// Function name -> file#
+		StringMap<unsigned> DefFuncs;
+		vector<pair<string, unsigned>> AddrTakenFuncs;
+};
+
+#endif
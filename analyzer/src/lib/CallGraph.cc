@@ -32,6 +32,9 @@
 #include "llvm/IR/CFG.h" 
 #include "llvm/Transforms/Utils/BasicBlockUtils.h" 
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/ModuleSummaryIndex.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Support/MemoryBuffer.h"
 
 #include "CallGraph.h"
 #include "Config.h"
@@ -39,10 +42,10 @@
 
 using namespace llvm;
 
-DenseMap<size_t, FuncSet> CallGraphPass::typeFuncsMap;
-unordered_map<size_t, set<size_t>> CallGraphPass::typeConfineMap;
-unordered_map<size_t, set<size_t>> CallGraphPass::typeTransitMap;
-set<size_t> CallGraphPass::typeEscapeSet;
+vector<FuncSet> CallGraphPass::typeFuncsMap;
+vector<set<unsigned>> CallGraphPass::typeConfineMap;
+vector<set<unsigned>> CallGraphPass::typeTransitMap;
+BitVector CallGraphPass::typeEscapeSet;
 const DataLayout *CurrentLayout;
 // Find targets of indirect calls based on type analysis: as long as
 // the number and type of parameters of a function matches with the
@@ -84,7 +87,9 @@ void CallGraphPass::findCalleesWithType(CallInst *CI, FuncSet &S) {
 			// Get actual type on caller side.
 			Type *ActualTy = (*AI)->getType();
 
-			if (DefinedTy == ActualTy)
+			// With -shared-context, same types of different
+			// modules are unified
+			if (getCanonicalType(DefinedTy) == getCanonicalType(ActualTy))
 				continue;
 
 			// FIXME: this is a tricky solution for disjoint
@@ -254,7 +259,7 @@ bool CallGraphPass::typeConfineInInitializer(User *Ini) {
 				Type *ITy = U->getType();
 				// TODO: use offset?
 				unsigned ONo = oi->getOperandNo();
-				typeFuncsMap[typeIdxHash(ITy, ONo)].insert(F);
+				fieldSlot(typeFuncsMap, Ctx->TypeIDs.getFieldID(ITy, ONo)).insert(F);
 			}
 			// Case 2: a composite-type object (value) is assigned to a
 			// field of another composite-type object
@@ -262,7 +267,8 @@ bool CallGraphPass::typeConfineInInitializer(User *Ini) {
 				// confine composite types
 				Type *ITy = U->getType();
 				unsigned ONo = oi->getOperandNo();
-				typeConfineMap[typeIdxHash(ITy, ONo)].insert(typeHash(OTy));
+				fieldSlot(typeConfineMap, Ctx->TypeIDs.getFieldID(ITy, ONo))
+					.insert(Ctx->TypeIDs.getTypeID(OTy));
 
 				// recognize nested composite types
 				User *OU = dyn_cast<User>(O);
@@ -302,7 +308,7 @@ bool CallGraphPass::typeConfineInStore(StoreInst *SI) {
 		Type *STy;
 		int Idx;
 		if (nextLayerBaseType(PO, STy, Idx, DL)) {
-			typeFuncsMap[typeIdxHash(STy, Idx)].insert(F);
+			fieldSlot(typeFuncsMap, Ctx->TypeIDs.getFieldID(STy, Idx)).insert(F);
 			return true;
 		}
 		else {
@@ -318,7 +324,8 @@ bool CallGraphPass::typeConfineInStore(StoreInst *SI) {
 	Type *VTy = VO->getType();
 	if (isCompositeType(VTy)) {
 		if (isCompositeType(EPTy)) {
-			typeConfineMap[typeHash(EPTy)].insert(typeHash(VTy));
+			fieldSlot(typeConfineMap, Ctx->TypeIDs.getFieldID(EPTy))
+				.insert(Ctx->TypeIDs.getTypeID(VTy));
 			return true;
 		}
 		else {
@@ -343,8 +350,8 @@ bool CallGraphPass::typeConfineInStore(StoreInst *SI) {
 	if (nextLayerBaseType(PO, STy, Idx, DL)) {
 		// The value operand is a pointer to a composite-type object
 		if (isCompositeType(EVTy)) {
-			typeConfineMap[typeIdxHash(STy,
-					Idx)].insert(typeHash(EVTy)); 
+			fieldSlot(typeConfineMap, Ctx->TypeIDs.getFieldID(STy, Idx))
+				.insert(Ctx->TypeIDs.getTypeID(EVTy));
 			return true;
 		}
 		else {
@@ -386,19 +393,20 @@ bool CallGraphPass::typeConfineInCast(CastInst *CastI) {
 }
 
 void CallGraphPass::escapeType(Type *Ty, int Idx) {
-	if (Idx == -1)
-		typeEscapeSet.insert(typeHash(Ty));
-	else
-		typeEscapeSet.insert(typeIdxHash(Ty, Idx));
+	unsigned FieldID = Ctx->TypeIDs.getFieldID(Ty, Idx);
+	if (FieldID >= typeEscapeSet.size())
+		typeEscapeSet.resize(FieldID + 1);
+	typeEscapeSet.set(FieldID);
 }
 
 void CallGraphPass::transitType(Type *ToTy, Type *FromTy,
 		int ToIdx, int FromIdx) {
 	if (ToIdx != -1 && FromIdx != -1)
-		typeTransitMap[typeIdxHash(ToTy, 
-				ToIdx)].insert(typeIdxHash(FromTy, FromIdx));
+		fieldSlot(typeTransitMap, Ctx->TypeIDs.getFieldID(ToTy, ToIdx))
+			.insert(Ctx->TypeIDs.getFieldID(FromTy, FromIdx));
 	else
-		typeTransitMap[typeHash(ToTy)].insert(typeHash(FromTy));
+		fieldSlot(typeTransitMap, Ctx->TypeIDs.getFieldID(ToTy))
+			.insert(Ctx->TypeIDs.getFieldID(FromTy));
 }
 
 void CallGraphPass::funcSetIntersection(FuncSet &FS1, FuncSet &FS2, 
@@ -473,9 +481,8 @@ bool CallGraphPass::findCalleesWithMLTA(CallInst *CI, FuncSet &FS) {
 	while (CV) {
 		// Step 1: ensure the type hasn't escaped
 #if 1
-		if ((typeEscapeSet.find(typeHash(LayerTy)) != typeEscapeSet.end()) || 
-				(typeEscapeSet.find(typeIdxHash(LayerTy, FieldIdx)) !=
-				 typeEscapeSet.end())) {
+		if (isEscaped(Ctx->TypeIDs.getFieldID(LayerTy)) ||
+				isEscaped(Ctx->TypeIDs.getFieldID(LayerTy, FieldIdx))) {
 
 			break;
 		}
@@ -483,22 +490,23 @@ bool CallGraphPass::findCalleesWithMLTA(CallInst *CI, FuncSet &FS) {
 
 		// Step 2: get the funcset and merge
 		++LayerNo;
-		FS2 = typeFuncsMap[typeIdxHash(LayerTy, FieldIdx)];
+		FS2 = fieldSlot(typeFuncsMap, Ctx->TypeIDs.getFieldID(LayerTy, FieldIdx));
 		FST.clear();
 		funcSetIntersection(FS1, FS2, FST);
 
 		// Step 3: get transitted funcsets and merge
 		// NOTE: this nested loop can be slow
 #if 1
-		unsigned TH = typeHash(LayerTy);
+		unsigned TH = Ctx->TypeIDs.getFieldID(LayerTy);
 		list<unsigned> LT;
 		LT.push_back(TH);
 		while (!LT.empty()) {
 			unsigned CT = LT.front();
 			LT.pop_front();
 
-			for (auto H : typeTransitMap[CT]) {
-				FS2 = typeFuncsMap[hashIdxHash(H, FieldIdx)];
+			for (auto H : fieldSlot(typeTransitMap, CT)) {
+				unsigned HT = Ctx->TypeIDs.getFieldType(H);
+				FS2 = fieldSlot(typeFuncsMap, Ctx->TypeIDs.getFieldID(HT, FieldIdx));
 				FST.clear();
 				funcSetIntersection(FS1, FS2, FST);
 				if (FST.size() != 0)
@@ -530,6 +538,9 @@ bool CallGraphPass::findCalleesWithMLTA(CallInst *CI, FuncSet &FS) {
 
 bool CallGraphPass::doInitialization(Module *M) {
 
+	// Assign canonical IDs to the types of the module once
+	Ctx->TypeIDs.addModule(M);
+
 	DL = &(M->getDataLayout());
 	CurrentLayout = DL;
 	Int8PtrTy = Type::getInt8PtrTy(M->getContext());
@@ -559,17 +570,15 @@ bool CallGraphPass::doInitialization(Module *M) {
 		if (F.isDeclaration())
 			continue;
 
-		for (inst_iterator i = inst_begin(F), e = inst_end(F); 
-				i != e; ++i) {
-			Instruction *I = &*i;
-
-			if (StoreInst *SI = dyn_cast<StoreInst>(I)) {
-				typeConfineInStore(SI);
-			}
-			else if (CastInst *CastI = dyn_cast<CastInst>(I)) {
-				typeConfineInCast(CastI);
-			}
+		// Stores and casts recorded by the fused scan, as type IDs
+		// need the type names collected from all modules
+		const FuncFacts &FF = Ctx->getFuncFacts(&F);
+		for (const MemFact &MF : FF.MemAccesses) {
+			if (MF.Kind == MA_STORE)
+				typeConfineInStore(cast<StoreInst>(MF.I));
 		}
+		for (CastInst *CastI : FF.Casts)
+			typeConfineInCast(CastI);
 
 		// Collect address-taken functions.
 		if (F.hasAddressTaken()) {
@@ -577,8 +586,9 @@ bool CallGraphPass::doInitialization(Module *M) {
 			Ctx->sigFuncsMap[funcHash(&F, false)].insert(&F);
 		}
 
-		// Collect global function definitions.
-		if (F.hasExternalLinkage() && !F.empty()) {
+		// Collect global function definitions, which may be not
+		// materialized yet
+		if (F.hasExternalLinkage() && !F.isDeclaration()) {
 			// External linkage always ends up with the function name.
 			StringRef FName = F.getName();
 			// Special case: make the names of syscalls consistent.
@@ -625,60 +635,140 @@ bool CallGraphPass::doModulePass(Module *M) {
 		// Unroll loops
 #ifdef UNROLL_LOOP_ONCE
 		unrollLoops(F);
+		// The CFG is changed, so extract the facts again
+		Ctx->FuncFactsMap.erase(F);
 #endif
 
-		// Collect callers and callees
-		for (inst_iterator i = inst_begin(F), e = inst_end(F); 
-				i != e; ++i) {
-			// Map callsite to possible callees.
-			if (CallInst *CI = dyn_cast<CallInst>(&*i)) {
-
-				CallSite CS(CI);
-				FuncSet FS;
-				Function *CF = CI->getCalledFunction();
-				Value *CV = CI->getCalledValue();
-				// Indirect call
-				if (CS.isIndirectCall()) {
+		collectCallees(F);
+	}
+
+	return false;
+}
+
+// Map the call sites of the function to their possible callees
+void CallGraphPass::collectCallees(Function *F) {
+
+	// Collect callers and callees
+	const FuncFacts &FF = Ctx->getFuncFacts(F);
+	for (const CallFact &Call : FF.Calls) {
+		// Map callsite to possible callees.
+		CallInst *CI = Call.CI;
+
+		CallSite CS(CI);
+		FuncSet FS;
+		Function *CF = Call.Callee;
+		Value *CV = CI->getCalledValue();
+		// Indirect call
+		if (CS.isIndirectCall()) {
 #ifdef MLTA_FOR_INDIRECT_CALL  
-					findCalleesWithMLTA(CI, FS);
+			findCalleesWithMLTA(CI, FS);
 #elif SOUND_MODE
-					findCalleesWithType(CI, FS);
+			findCalleesWithType(CI, FS);
 #endif
 
-					for (Function *Callee : FS)
-						Ctx->Callers[Callee].insert(CI);
+			for (Function *Callee : FS)
+				Ctx->Callers[Callee].insert(CI);
 
-					// Save called values for future uses.
-					Ctx->IndirectCallInsts.push_back(CI);
+			// Save called values for future uses.
+			Ctx->IndirectCallInsts.push_back(CI);
+		}
+		// Direct call
+		else {
+			// not InlineAsm
+			if (CF) {
+				// Call external functions
+				if (CF->isDeclaration()) {
+					StringRef FName = CF->getName();
+					if (FName.startswith("SyS_"))
+						FName = StringRef("sys_" + FName.str().substr(4));
+					if (Function *GF = Ctx->GlobalFuncs[FName])
+						CF = GF;
 				}
-				// Direct call
-				else {
-					// not InlineAsm
-					if (CF) {
-						// Call external functions
-						if (CF->empty()) {
-							StringRef FName = CF->getName();
-							if (FName.startswith("SyS_"))
-								FName = StringRef("sys_" + FName.str().substr(4));
-							if (Function *GF = Ctx->GlobalFuncs[FName])
-								CF = GF;
-						}
-						// Use unified function
-						size_t fh = funcHash(CF);
-						CF = Ctx->UnifiedFuncMap[fh];
-						if (CF) {
-							FS.insert(CF);
-							Ctx->Callers[CF].insert(CI);
-						}
-					}
-					// InlineAsm
-					else {
-					}
+				// Use unified function
+				Function *DF = CF;
+				size_t fh = funcHash(CF);
+				CF = Ctx->UnifiedFuncMap[fh];
+				// Functions of the core kernel, which is not loaded,
+				// are represented by one of their declarations
+				if (!CF && Ctx->CoreCallSites.count(DF->getName())) {
+					Function *&RF = Ctx->CoreFuncs[DF->getName()];
+					if (!RF)
+						RF = DF;
+					CF = RF;
 				}
-				Ctx->Callees[CI] = FS;
+				if (CF) {
+					FS.insert(CF);
+					Ctx->Callers[CF].insert(CI);
+				}
+			}
+			// InlineAsm
+			else {
 			}
 		}
+		Ctx->Callees[CI] = FS;
 	}
+}
 
-	return false;
+// Seed the function-level call graph and the address-taken functions
+// from the module summaries, so that function bodies need not be
+// loaded. Calls in the summaries are direct ones; referenced
+// functions are conservatively treated as address-taken.
+void CallGraphPass::buildFromSummaries(ModuleList &modules) {
+
+	// Map GUIDs to functions, preferring unified definitions
+	DenseMap<GlobalValue::GUID, Function *> GUIDFuncMap;
+	for (auto M : modules) {
+		for (Function &F : *M.first) {
+			if (F.isDeclaration()) {
+				GUIDFuncMap.insert(make_pair(F.getGUID(), &F));
+				continue;
+			}
+			Function *UF = Ctx->UnifiedFuncMap[funcHash(&F)];
+			GUIDFuncMap[F.getGUID()] = UF ? UF : &F;
+		}
+	}
+
+	unsigned NumModules = 0;
+	for (auto M : modules) {
+		auto Buf = MemoryBuffer::getFile(M.second);
+		if (!Buf)
+			continue;
+		Expected<BitcodeLTOInfo> LTOInfo = getBitcodeLTOInfo(**Buf);
+		if (!LTOInfo || !LTOInfo->HasSummary) {
+			consumeError(LTOInfo.takeError());
+			continue;
+		}
+		Expected<unique_ptr<ModuleSummaryIndex>> Index =
+			getModuleSummaryIndex(**Buf);
+		if (!Index) {
+			consumeError(Index.takeError());
+			continue;
+		}
+		++NumModules;
+
+		for (auto &GVS : **Index) {
+			Function *F = GUIDFuncMap.lookup(GVS.first);
+			for (auto &S : GVS.second.SummaryList) {
+				for (ValueInfo Ref : S->refs()) {
+					Function *RF = GUIDFuncMap.lookup(Ref.getGUID());
+					if (RF && Ctx->AddressTakenFuncs.insert(RF).second)
+						Ctx->sigFuncsMap[funcHash(RF, false)].insert(RF);
+				}
+
+				FunctionSummary *FS = dyn_cast<FunctionSummary>(S.get());
+				if (!F || !FS)
+					continue;
+				for (auto &Edge : FS->calls()) {
+					Function *CF = GUIDFuncMap.lookup(Edge.first.getGUID());
+					if (!CF)
+						continue;
+					Ctx->SummaryCallees[F].insert(CF);
+					Ctx->SummaryCallers[CF].insert(F);
+				}
+			}
+		}
+	}
+
+	OP << "[" << ID << "] Seeded from summaries of " << NumModules
+		<< " / " << modules.size() << " modules\n";
 }
@@ -3,6 +3,8 @@
 
 #include "Analyzer.h"
 
+#include <llvm/ADT/BitVector.h>
+
 class CallGraphPass : public IterativeModulePass {
 
 	private:
@@ -12,10 +14,21 @@ class CallGraphPass : public IterativeModulePass {
 		// long interger type
 		Type *IntPtrTy;
 
-		static DenseMap<size_t, FuncSet>typeFuncsMap;
-		static unordered_map<size_t, set<size_t>>typeConfineMap;
-		static unordered_map<size_t, set<size_t>>typeTransitMap;
-		static set<size_t>typeEscapeSet;
+		// Indexed by field IDs of Ctx->TypeIDs
+		static vector<FuncSet>typeFuncsMap;
+		static vector<set<unsigned>>typeConfineMap;
+		static vector<set<unsigned>>typeTransitMap;
+		static BitVector typeEscapeSet;
+
+		template <typename T>
+		static T &fieldSlot(vector<T> &V, unsigned FieldID) {
+			if (FieldID >= V.size())
+				V.resize(FieldID + 1);
+			return V[FieldID];
+		}
+		bool isEscaped(unsigned FieldID) {
+			return FieldID < typeEscapeSet.size() && typeEscapeSet.test(FieldID);
+		}
 
 		// Use type-based analysis to find targets of indirect calls
 		void findCalleesWithType(llvm::CallInst*, FuncSet&);
@@ -45,6 +58,8 @@ class CallGraphPass : public IterativeModulePass {
 		virtual bool doFinalization(llvm::Module *);
 		virtual bool doModulePass(llvm::Module *);
 
+		void collectCallees(Function *F);
+		void buildFromSummaries(ModuleList &modules);
 };
 
 #endif
@@ -162,52 +162,97 @@ DILocation *getSourceLocation(Instruction *I) {
 	return Loc;
 }
 
-/// Print out source code information to facilitate manual analyses.
-void printSourceCodeInfo(Value *V) {
+/// Get the source file, line number, and code line of an instruction
+bool getSourceInfo(Value *V, SourceInfo &SI, bool FetchLine) {
 	Instruction *I = dyn_cast<Instruction>(V);
 	if (!I)
-		return;
+		return false;
 
 	DILocation *Loc = getSourceLocation(I);
 	if (!Loc)
-		return;
+		return false;
 
-	unsigned LineNo = Loc->getLine();
-	std::string FN = getFileName(Loc);
-	string line = getSourceLine(FN, LineNo);
-	FN = Loc->getFilename().str();
-	FN = FN.substr(FN.find('/') + 1);
-	FN = FN.substr(FN.find('/') + 1);
+	SI.LineNo = Loc->getLine();
+	SI.Path = getFileName(Loc);
+	SI.Line = FetchLine ? getSourceLine(SI.Path, SI.LineNo) : "";
+	SI.File = Loc->getFilename().str();
+	SI.File = SI.File.substr(SI.File.find('/') + 1);
+	SI.File = SI.File.substr(SI.File.find('/') + 1);
 
-	while(line[0] == ' ' || line[0] == '\t')
-		line.erase(line.begin());
-	OP << " ["
-		<< "\033[34m" << "Code" << "\033[0m" << "] "
-		<< FN
-		<< " +" << LineNo << ": "
-		<< "\033[35m" << line << "\033[0m" <<'\n';
+	while(SI.Line[0] == ' ' || SI.Line[0] == '\t')
+		SI.Line.erase(SI.Line.begin());
+	return true;
 }
 
-void printSourceCodeInfo(Function *F) {
+/// Get the source file, line number, and code line of a function
+bool getSourceInfo(Function *F, SourceInfo &SI, bool FetchLine) {
 
 	DISubprogram *SP = F->getSubprogram();
+	if (!SP)
+		return false;
+
+	SI.LineNo = SP->getLine();
+	SI.Path = getFileName(NULL, SP);
+	SI.Line = FetchLine ? getSourceLine(SI.Path, SI.LineNo) : "";
+	SI.File = SP->getFilename().str();
+	SI.File = SI.File.substr(SI.File.find('/') + 1);
+	SI.File = SI.File.substr(SI.File.find('/') + 1);
+
+	while(SI.Line[0] == ' ' || SI.Line[0] == '\t')
+		SI.Line.erase(SI.Line.begin());
+	return true;
+}
 
-	if (SP) {
-		string FN = getFileName(NULL, SP);
-		string line = getSourceLine(FN, SP->getLine());
-		while(line[0] == ' ' || line[0] == '\t')
-			line.erase(line.begin());
+/// Fill in the code lines of source locations, reading each source
+/// file only once
+void fetchSourceLines(vector<SourceInfo *> &SIs) {
 
-		FN = SP->getFilename().str();
-		FN = FN.substr(FN.find('/') + 1);
-		FN = FN.substr(FN.find('/') + 1);
-
-		OP << " ["
-			<< "\033[34m" << "Code" << "\033[0m" << "] "
-			<< FN
-			<< " +" << SP->getLine() << ": "
-			<< "\033[35m" << line << "\033[0m" <<'\n';
+	map<string, vector<SourceInfo *>> FileSIs;
+	for (SourceInfo *SI : SIs) {
+		if (SI->Line.empty() && !SI->Path.empty())
+			FileSIs[SI->Path].push_back(SI);
 	}
+
+	for (auto &FS : FileSIs) {
+		std::sort(FS.second.begin(), FS.second.end(),
+				[](SourceInfo *SI1, SourceInfo *SI2) {
+				return SI1->LineNo < SI2->LineNo; });
+
+		std::ifstream sourcefile(FS.first);
+		string line;
+		unsigned LineNo = 0;
+		for (SourceInfo *SI : FS.second) {
+			while (LineNo < SI->LineNo && getline(sourcefile, line))
+				++LineNo;
+			if (LineNo != SI->LineNo)
+				break;
+
+			SI->Line = line;
+			while(SI->Line[0] == ' ' || SI->Line[0] == '\t')
+				SI->Line.erase(SI->Line.begin());
+		}
+	}
+}
+
+void printSourceInfo(const SourceInfo &SI, raw_ostream &OS) {
+	OS << " ["
+		<< "\033[34m" << "Code" << "\033[0m" << "] "
+		<< SI.File
+		<< " +" << SI.LineNo << ": "
+		<< "\033[35m" << SI.Line << "\033[0m" <<'\n';
+}
+
+/// Print out source code information to facilitate manual analyses.
+void printSourceCodeInfo(Value *V) {
+	SourceInfo SI;
+	if (getSourceInfo(V, SI))
+		printSourceInfo(SI);
+}
+
+void printSourceCodeInfo(Function *F) {
+	SourceInfo SI;
+	if (getSourceInfo(F, SI))
+		printSourceInfo(SI);
 }
 
 string getMacroInfo(Value *V) {
@@ -299,7 +344,7 @@ size_t funcHash(Function *F, bool withName) {
 #endif
 		string sig;
 		raw_string_ostream rso(sig);
-		Type *FTy = F->getFunctionType();
+		Type *FTy = getCanonicalType(F->getFunctionType());
 		FTy->print(rso);
 		output = rso.str();
 
@@ -326,7 +371,7 @@ size_t callHash(CallInst *CI) {
 		hash<string> str_hash;
 		string sig;
 		raw_string_ostream rso(sig);
-		Type *FTy = CS.getFunctionType();
+		Type *FTy = getCanonicalType(CS.getFunctionType());
 		FTy->print(rso);
 
 		string strip_str = rso.str();
@@ -337,6 +382,122 @@ size_t callHash(CallInst *CI) {
 	}
 }
 
+DenseMap<Type *, Type *> CanonicalTypeMap;
+
+// Like the linker, assume the struct types being compared are
+// isomorphic, to terminate on recursive types
+static bool areTypesIsomorphic(Type *A, Type *B,
+		DenseMap<Type *, Type *> &AssumedMap) {
+
+	A = getCanonicalType(A);
+	B = getCanonicalType(B);
+	if (A == B)
+		return true;
+	if (A->getTypeID() != B->getTypeID()
+			|| A->getNumContainedTypes() != B->getNumContainedTypes())
+		return false;
+
+	if (StructType *SA = dyn_cast<StructType>(A)) {
+		StructType *SB = cast<StructType>(B);
+		if (SA->isOpaque() || SB->isOpaque()
+				|| SA->isPacked() != SB->isPacked())
+			return false;
+		auto It = AssumedMap.find(A);
+		if (It != AssumedMap.end())
+			return It->second == B;
+		AssumedMap[A] = B;
+	}
+	else if (PointerType *PA = dyn_cast<PointerType>(A)) {
+		if (PA->getAddressSpace() != B->getPointerAddressSpace())
+			return false;
+	}
+	else if (ArrayType *AA = dyn_cast<ArrayType>(A)) {
+		if (AA->getNumElements() != B->getArrayNumElements())
+			return false;
+	}
+	else if (FunctionType *FA = dyn_cast<FunctionType>(A)) {
+		if (FA->isVarArg() != cast<FunctionType>(B)->isVarArg())
+			return false;
+	}
+	else if (A->isVectorTy() || A->isIntegerTy())
+		// Not uniqued by the contained types only
+		return false;
+
+	for (unsigned i = 0; i < A->getNumContainedTypes(); ++i) {
+		if (!areTypesIsomorphic(A->getContainedType(i),
+					B->getContainedType(i), AssumedMap))
+			return false;
+	}
+	return true;
+}
+
+// Strip the ".<number>" suffix added to a struct name on conflicts
+static StringRef stripNameSuffix(StringRef Name) {
+
+	StringRef BaseName = Name.rsplit('.').first;
+	if (BaseName.size() == Name.size()
+			|| Name.substr(BaseName.size() + 1).find_first_not_of(
+				"0123456789") != StringRef::npos)
+		return Name;
+	return BaseName;
+}
+
+void canonicalizeStructTypes(Module *M) {
+
+	for (StructType *STy : M->getIdentifiedStructTypes()) {
+		if (!STy->hasName() || CanonicalTypeMap.count(STy))
+			continue;
+
+		StringRef Name = STy->getName();
+		StringRef BaseName = stripNameSuffix(Name);
+		if (BaseName.size() == Name.size())
+			continue;
+
+		StructType *BaseTy = M->getTypeByName(BaseName);
+		if (!BaseTy || BaseTy == STy)
+			continue;
+
+		DenseMap<Type *, Type *> AssumedMap;
+		if (areTypesIsomorphic(STy, BaseTy, AssumedMap))
+			CanonicalTypeMap[STy] = getCanonicalType(BaseTy);
+	}
+}
+
+Type *getCanonicalType(Type *Ty) {
+
+	if (CanonicalTypeMap.empty())
+		return Ty;
+
+	if (PointerType *PTy = dyn_cast<PointerType>(Ty)) {
+		Type *ETy = getCanonicalType(PTy->getElementType());
+		if (ETy == PTy->getElementType())
+			return Ty;
+		return PointerType::get(ETy, PTy->getAddressSpace());
+	}
+	if (ArrayType *ATy = dyn_cast<ArrayType>(Ty)) {
+		Type *ETy = getCanonicalType(ATy->getElementType());
+		if (ETy == ATy->getElementType())
+			return Ty;
+		return ArrayType::get(ETy, ATy->getNumElements());
+	}
+	if (FunctionType *FTy = dyn_cast<FunctionType>(Ty)) {
+		bool Changed = false;
+		SmallVector<Type *, 8> Params;
+		for (Type *PTy : FTy->params()) {
+			Params.push_back(getCanonicalType(PTy));
+			Changed |= Params.back() != PTy;
+		}
+		Type *RTy = getCanonicalType(FTy->getReturnType());
+		Changed |= RTy != FTy->getReturnType();
+		if (!Changed)
+			return Ty;
+		return FunctionType::get(RTy, Params, FTy->isVarArg());
+	}
+
+	auto It = CanonicalTypeMap.find(Ty);
+	return It == CanonicalTypeMap.end() ? Ty : It->second;
+}
+
 string HandleSimpleTy(Type *Ty){
 	unsigned size = Ty->getScalarSizeInBits();
 	string ret = std::to_string(size);
@@ -357,19 +518,18 @@ string expand_struct(StructType *STy) {
 }
 
 
-size_t typeHash(Type *Ty) {
-	hash<string> str_hash;
-	string sig;
+// The key of a type: its name and layout
+static string typeKey(Type *Ty) {
 
-	raw_string_ostream rso(sig);
 	string ty_str = "";
+	Ty = getCanonicalType(Ty);
 	StructType *STy = dyn_cast<StructType>(Ty);
 	if (STy == NULL)
 		ty_str = ty_str+HandleSimpleTy(Ty);
 	else {
 		//Struct type
 		if (STy->hasName()) {
-			string STyname = STy->getName();
+			string STyname = stripNameSuffix(STy->getName());
 			ty_str = ty_str + STyname + expand_struct(STy);
 		} else if (TypeToTNameMap.find(Ty) != TypeToTNameMap.end()){
 			ty_str = ty_str + TypeToTNameMap[Ty]+expand_struct(STy);
@@ -377,21 +537,39 @@ size_t typeHash(Type *Ty) {
 			ty_str = ty_str +  expand_struct(STy);
 		}
 	}
-	
-	
+
 	string::iterator end_pos = remove(ty_str.begin(), ty_str.end(), ' ');
 	ty_str.erase(end_pos, ty_str.end());
 
-	return str_hash(ty_str);
+	return ty_str;
 }
 
-size_t hashIdxHash(size_t Hs, int Idx) {
-	hash<string> str_hash;
-	return Hs + str_hash(to_string(Idx));
+void TypeIDTable::addModule(Module *M) {
+
+	CurrentLayout = &M->getDataLayout();
+	for (StructType *STy : M->getIdentifiedStructTypes())
+		getTypeID(STy);
 }
 
-size_t typeIdxHash(Type *Ty, int Idx) {
-	return hashIdxHash(typeHash(Ty), Idx);
+unsigned TypeIDTable::getTypeID(Type *Ty) {
+
+	auto It = TypeIDMap.find(Ty);
+	if (It != TypeIDMap.end())
+		return It->second;
+
+	unsigned ID = TypeKeyMap.insert(
+			make_pair(typeKey(Ty), TypeKeyMap.size())).first->second;
+	TypeIDMap[Ty] = ID;
+	return ID;
+}
+
+unsigned TypeIDTable::getFieldID(unsigned TyID, int Idx) {
+
+	auto It = FieldIDMap.insert(
+			make_pair(make_pair(TyID, Idx), FieldTypes.size()));
+	if (It.second)
+		FieldTypes.push_back(TyID);
+	return It.first->second;
 }
 
 void getSourceCodeLine(Value *V, string &line) {
@@ -418,3 +596,129 @@ void getSourceCodeLine(Value *V, string &line) {
 	return;
 }
 
+
+//
+// Implementation of FuncRoleTable
+//
+
+/// FNV-1a hash of a function name
+uint64_t FuncRoleTable::nameHash(StringRef Name) {
+	uint64_t H = 0xcbf29ce484222325ULL;
+	for (char C : Name) {
+		H ^= (uint8_t)C;
+		H *= 0x100000001b3ULL;
+	}
+	return H;
+}
+
+FuncRoleInfo &FuncRoleTable::add(StringRef Name, uint8_t Roles) {
+
+	auto It = NameIdx.find(Name);
+	if (It == NameIdx.end()) {
+		FuncRoleInfo FRI = {FR_NONE, -1, -1, -1, -1, -1};
+		It = NameIdx.insert(make_pair(Name, (unsigned)Names.size())).first;
+		Names.push_back(Name.str());
+		Infos.push_back(FRI);
+	}
+	FuncRoleInfo &FRI = Infos[It->second];
+	FRI.Roles |= Roles;
+	return FRI;
+}
+
+/// Build the perfect hash with hash-and-displace: names are grouped
+/// into buckets by the high half of their hash; starting from the
+/// largest bucket, each bucket searches a displacement that places
+/// all of its names into free slots.
+void FuncRoleTable::build() {
+
+	unsigned N = Names.size();
+	uint64_t NumSlots = NextPowerOf2(N + N / 4);
+
+	while (true) {
+		Mask = NumSlots - 1;
+		unsigned NumBuckets = NumSlots / 4 + 1;
+		vector<vector<unsigned>> Buckets(NumBuckets);
+		for (unsigned i = 0; i < N; ++i)
+			Buckets[(nameHash(Names[i]) >> 32) % NumBuckets].push_back(i);
+
+		vector<unsigned> Order(NumBuckets);
+		for (unsigned b = 0; b < NumBuckets; ++b)
+			Order[b] = b;
+		stable_sort(Order.begin(), Order.end(), 
+				[&](unsigned B1, unsigned B2) {
+				return Buckets[B1].size() > Buckets[B2].size();
+				});
+
+		Disps.assign(NumBuckets, 0);
+		Slots.assign(NumSlots, -1);
+		bool Failed = false;
+		for (unsigned b : Order) {
+			if (Buckets[b].empty())
+				break;
+
+			uint32_t D = 0;
+			for (; D < (1U << 16); ++D) {
+				vector<uint64_t> Placed;
+				for (unsigned i : Buckets[b]) {
+					uint64_t H = nameHash(Names[i]);
+					uint64_t S = ((uint32_t)H + D * ((H >> 32) | 1)) & Mask;
+					if (Slots[S] != -1 || 
+							find(Placed.begin(), Placed.end(), S) != Placed.end())
+						break;
+					Placed.push_back(S);
+				}
+				if (Placed.size() != Buckets[b].size())
+					continue;
+				for (unsigned k = 0; k < Placed.size(); ++k)
+					Slots[Placed[k]] = Buckets[b][k];
+				Disps[b] = D;
+				break;
+			}
+			if (D == (1U << 16)) {
+				Failed = true;
+				break;
+			}
+		}
+		if (!Failed)
+			break;
+		// Retry with a sparser table
+		NumSlots *= 2;
+	}
+}
+
+const FuncRoleInfo *FuncRoleTable::lookup(StringRef Name) const {
+
+	if (Slots.empty())
+		return NULL;
+
+	uint64_t H = nameHash(Name);
+	uint32_t D = Disps[(H >> 32) % Disps.size()];
+	int Idx = Slots[((uint32_t)H + D * ((H >> 32) | 1)) & Mask];
+	if (Idx < 0 || Names[Idx] != Name)
+		return NULL;
+	return &Infos[Idx];
+}
+
+void FuncRoleTable::tagFunction(Function *F) {
+
+	if (const FuncRoleInfo *FRI = lookup(F->getName()))
+		FuncTags[F] = FRI;
+}
+
+const FuncRoleInfo *FuncRoleTable::lookupCall(Instruction *I) const {
+
+	Function *CF = NULL;
+	if (CallInst *CI = dyn_cast<CallInst>(I))
+		CF = CI->getCalledFunction();
+	else if (InvokeInst *II = dyn_cast<InvokeInst>(I))
+		CF = II->getCalledFunction();
+
+	// Direct calls only need the tag; all functions are tagged when
+	// the modules are loaded
+	if (CF) {
+		auto It = FuncTags.find(CF);
+		return It == FuncTags.end() ? NULL : It->second;
+	}
+
+	return lookup(getCalledFuncName(I));
+}
@@ -6,10 +6,14 @@
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Support/CommandLine.h>
 #include <llvm/IR/DebugInfo.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringMap.h>
 
 #include <unistd.h>
 #include <bitset>
 #include <chrono>
+#include <vector>
+#include <string>
 
 using namespace llvm;
 using namespace std;
@@ -45,6 +49,7 @@ using namespace std;
 extern cl::opt<unsigned> VerboseLevel;
 extern map<Type*, string> TypeToTNameMap;
 extern const DataLayout *CurrentLayout;
+extern DenseMap<Type *, Type *> CanonicalTypeMap;
 
 //
 // Common functions
@@ -67,6 +72,19 @@ DILocation *getSourceLocation(Instruction *I);
 
 void printSourceCodeInfo(Value *V);
 void printSourceCodeInfo(Function *F);
+
+// Source location and code line of an instruction or function
+struct SourceInfo {
+	string File;
+	unsigned LineNo;
+	string Line;
+	// Path of the source file, for fetching the code line later
+	string Path;
+};
+bool getSourceInfo(Value *V, SourceInfo &SI, bool FetchLine = true);
+bool getSourceInfo(Function *F, SourceInfo &SI, bool FetchLine = true);
+void fetchSourceLines(vector<SourceInfo *> &SIs);
+void printSourceInfo(const SourceInfo &SI, raw_ostream &OS = OP);
 string getMacroInfo(Value *V);
 
 void getSourceCodeInfo(Value *V, string &file,
@@ -76,9 +94,11 @@ Argument *getArgByNo(Function *F, int8_t ArgNo);
 
 size_t funcHash(Function *F, bool withName = true);
 size_t callHash(CallInst *CI);
-size_t typeHash(Type *Ty);
-size_t typeIdxHash(Type *Ty, int Idx = -1);
-size_t hashIdxHash(size_t Hs, int Idx = -1);
+
+// Map renamed copies of struct types, e.g., "struct.foo.12", to the
+// isomorphic original when modules share an LLVMContext
+void canonicalizeStructTypes(Module *M);
+Type *getCanonicalType(Type *Ty);
 
 string HandleSimpleTy(Type *Ty);
 string expand_struct(StructType *STy);
@@ -202,6 +222,101 @@ public:
 
 extern Dumper DUMP;
 
+//
+// Modeled functions
+//
+// Roles of modeled functions, a function may have several
+enum FuncRole {
+  FR_NONE = 0,
+  FR_ERR_HANDLE = 1,  /* Handles errors, e.g., BUG_ON, pr_err */
+  FR_COPY = 2,        /* Copies/moves values, e.g., memcpy */
+  FR_DATA_FETCH = 4,  /* Fetches external data, e.g., copy_from_user */
+  FR_SKIP = 8,        /* Uninteresting callee, e.g., kfree, printk */
+};
+
+struct FuncRoleInfo {
+  uint8_t Roles;
+  // <src, dst, size> of copy functions
+  int8_t CopySrc, CopyDst, CopySize;
+  // <dst, src> of data-fetch functions
+  int8_t FetchDst, FetchSrc;
+};
+
+// Table of modeled functions. Names are interned once and compiled
+// into a perfect hash, so a lookup needs no string allocation and
+// only one string comparison. Functions are further tagged with
+// their roles so that direct calls only need a pointer lookup.
+class FuncRoleTable {
+public:
+  FuncRoleTable() : Mask(0) {}
+
+  // Add roles to a modeled function; must happen before build()
+  FuncRoleInfo &add(StringRef Name, uint8_t Roles);
+  // Compile the added functions into the perfect hash
+  void build();
+
+  // Look up a modeled function by name
+  const FuncRoleInfo *lookup(StringRef Name) const;
+  // Tag the function with its role, if it is modeled
+  void tagFunction(Function *F);
+  // Look up the role of the function called by I
+  const FuncRoleInfo *lookupCall(Instruction *I) const;
+  // Get the roles of a tagged function
+  uint8_t getRoles(Function *F) const {
+    auto It = FuncTags.find(F);
+    return It == FuncTags.end() ? (uint8_t)FR_NONE : It->second->Roles;
+  }
+
+  size_t size() const { return Names.size(); }
+
+private:
+  static uint64_t nameHash(StringRef Name);
+
+  // Interned names and their roles, indexed alike
+  vector<string> Names;
+  vector<FuncRoleInfo> Infos;
+  StringMap<unsigned> NameIdx;
+
+  // Perfect hash: displacement per bucket, name index per slot
+  vector<uint32_t> Disps;
+  vector<int> Slots;
+  uint64_t Mask;
+
+  // Tagged functions
+  DenseMap<Function *, const FuncRoleInfo *> FuncTags;
+};
+
+//
+// Type identification
+//
+// Canonical dense IDs of types across modules. A type is identified
+// by its name, with the ".<number>" suffix stripped, and its layout;
+// each Type* is keyed only once. Fields (or elements) of composite
+// types get dense IDs as well, where field -1 is the type itself,
+// so that both can index arrays directly.
+class TypeIDTable {
+public:
+  // Assign IDs to the struct types of the module
+  void addModule(Module *M);
+
+  unsigned getTypeID(Type *Ty);
+  unsigned getFieldID(unsigned TyID, int Idx = -1);
+  unsigned getFieldID(Type *Ty, int Idx = -1) {
+    return getFieldID(getTypeID(Ty), Idx);
+  }
+  // Get the type ID of a field ID
+  unsigned getFieldType(unsigned FieldID) { return FieldTypes[FieldID]; }
+
+  unsigned getNumTypes() { return TypeKeyMap.size(); }
+  unsigned getNumFields() { return FieldTypes.size(); }
+
+private:
+  DenseMap<Type *, unsigned> TypeIDMap;
+  StringMap<unsigned> TypeKeyMap;
+  DenseMap<pair<unsigned, int>, unsigned> FieldIDMap;
+  vector<unsigned> FieldTypes;
+};
+
 class SecurityCheck {
 public:
   SecurityCheck(Value *sk, Value *br) : SCheck(sk), SCBranch(br) {
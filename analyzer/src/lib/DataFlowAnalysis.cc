@@ -39,26 +39,14 @@ void DataFlowAnalysis::getAliasPointers(Value *Addr,
 void DataFlowAnalysis::collectSuccReachBlocks(BasicBlock *BB,
 		set<BasicBlock *> &reachBB) {
 
-	if (reachBB.find(BB) != reachBB.end())
-		return;
-	reachBB.insert(BB);
-
-	succ_iterator si = succ_begin(BB), se = succ_end(BB);
-	for (; si != se; ++si)
-		collectSuccReachBlocks(*si, reachBB);
+	Ctx->getFuncFacts(BB->getParent()).collectReachBlocks(BB, true, reachBB);
 }
 
 /// Collect pred reachable basic blocks
 void DataFlowAnalysis::collectPredReachBlocks(BasicBlock *BB,
 		set<BasicBlock *> &reachBB) {
 
-	if (reachBB.find(BB) != reachBB.end())
-		return;
-	reachBB.insert(BB);
-
-	pred_iterator pi = pred_begin(BB), pe = pred_end(BB);
-	for (; pi != pe; ++pi)
-		collectPredReachBlocks(*pi, reachBB);
+	Ctx->getFuncFacts(BB->getParent()).collectReachBlocks(BB, false, reachBB);
 }
 
 /// Track the sources and same-origin critical variables of the
@@ -90,13 +78,14 @@ void DataFlowAnalysis::findSourceCVAlias(
 			if (!CaV) 
 				continue;
 
-			StringRef FuncName = getCalledFuncName(CI);
+			const FuncRoleInfo *FRI = Ctx->ModeledFuncs.lookupCall(CI);
+			if (!FRI)
+				continue;
 			Value *Src = NULL;
-			auto dit = Ctx->DataFetchFuncs.find(FuncName.str());
-			if (dit != Ctx->DataFetchFuncs.end()) {
+			if (FRI->Roles & FR_DATA_FETCH) {
 				// FIXME: assume the dst is arg 0
-				if (dit->second.first == 0) {
-					Src = CI->getArgOperand(dit->second.second);
+				if (FRI->FetchDst == 0) {
+					Src = CI->getArgOperand(FRI->FetchSrc);
 				}
 			}
 			if (Src) {
@@ -108,8 +97,7 @@ void DataFlowAnalysis::findSourceCVAlias(
 				continue;
 			}
 
-			auto cit = Ctx->CopyFuncs.find(FuncName.str());
-			if (cit != Ctx->CopyFuncs.end()) {
+			if (FRI->Roles & FR_COPY) {
 				// FIXME: assume the src is arg 1
 				Value *Src = CI->getArgOperand(1);
 				findSourceCV(Src, SourceSet, CVSet, TrackedSet);
@@ -183,17 +171,16 @@ void DataFlowAnalysis::findSourceCV(Value *V, set<Value *> &SourceSet,
 		// TODO: track callers
 		Value *CaV = CI->getCalledValue();
 		if (CaV) {
-			StringRef FuncName = getCalledFuncName(CI);
+			const FuncRoleInfo *FRI = Ctx->ModeledFuncs.lookupCall(CI);
 			Value *Src = NULL;
-			auto it = Ctx->DataFetchFuncs.find(FuncName.str());
-			if (it != Ctx->DataFetchFuncs.end()) {
+			if (FRI && (FRI->Roles & FR_DATA_FETCH)) {
 				// Functions like memdup_user
-				if (it->second.first == -1) {
-					Src = CI->getArgOperand(it->second.second);
+				if (FRI->FetchDst == -1) {
+					Src = CI->getArgOperand(FRI->FetchSrc);
 				}
 			}
 			else if (dyn_cast<InlineAsm>(CaV) 
-					&& FuncName.contains("get_user")) {
+					&& getCalledFuncName(CI).contains("get_user")) {
 				Src = CI->getArgOperand(0);
 			}
 			if (Src) {
@@ -239,7 +226,7 @@ void DataFlowAnalysis::findSourceCV(Value *V, set<Value *> &SourceSet,
 		// Get aliases
 		Function *F = LI->getParent()->getParent();
 		std::set<Value *> AliasSet;
-		getAliasPointers(LPO, AliasSet, Ctx->FuncPAResults[F]);
+		getAliasPointers(LPO, AliasSet, Ctx->getPAResults(F));
 
 		// To find all stores using the pointer
 		// TODO: use alias analysis
@@ -348,7 +335,7 @@ void DataFlowAnalysis::findInFuncSourceCV(Value *V, set<Value *> &SourceSet,
 		// Get aliases
 		Function *F = LI->getParent()->getParent();
 		std::set<Value *> AliasSet;
-		getAliasPointers(LPO, AliasSet, Ctx->FuncPAResults[F]);
+		getAliasPointers(LPO, AliasSet, Ctx->getPAResults(F));
 
 		// To find all stores using the pointer
 		// TODO: use alias analysis
@@ -576,7 +563,7 @@ void DataFlowAnalysis::findUses(Instruction *BorderInsn, Value *Target,
 			else {
 				set<Value *> AliasSet;
 				getAliasPointers(SI->getPointerOperand(), AliasSet, 
-						Ctx->FuncPAResults[SI->getParent()->getParent()]);
+						Ctx->getPAResults(SI->getParent()->getParent()));
 				for (Value *A : AliasSet) {
 					for (User *AU : A->users()) {
 
@@ -604,6 +591,11 @@ void DataFlowAnalysis::findUses(Instruction *BorderInsn, Value *Target,
 
 		//Use 3: Taking parameters in a function call
 		if (CallInst *CI = dyn_cast<CallInst>(U)) {
+			// Uninteresting callees such as kfree are not critical uses
+			const FuncRoleInfo *FRI = Ctx->ModeledFuncs.lookupCall(CI);
+			if (FRI && (FRI->Roles & FR_SKIP))
+				continue;
+
 			// Used as the callee or parameter of a CallInst
 			// Mark it as a critical use
 			if (reachBBs.find(BB) != reachBBs.end()) {
@@ -735,14 +727,14 @@ void DataFlowAnalysis::performBackwardAnalysis(Function* F, Value* V,
 		else
 			LPSet.insert(LI->getPointerOperand());
 
-		for (auto i = inst_begin(F), e = inst_end(F); i != e; ++i) {
-			StoreInst *SI = dyn_cast<StoreInst>(&*i);
-			if (!SI) 
+		const FuncFacts &FF = Ctx->getFuncFacts(F);
+		int PtrID = FF.getPointerID(LI->getPointerOperand());
+		for (const MemFact &MF : FF.MemAccesses) {
+			if (MF.Kind != MA_STORE || (int)MF.PtrID != PtrID)
 				continue;
+			StoreInst *SI = cast<StoreInst>(MF.I);
 			if (!possibleUseStResult(LI, SI)) 
 				continue;
-			if (SI->getPointerOperand() != LI->getPointerOperand()) 
-				continue;
 			performBackwardAnalysis(F, SI->getValueOperand(), CISet);
 		}
 		return;
@@ -0,0 +1,180 @@
+//===-- FuncFacts.cc - Extract facts of functions-----------------===//
+//
+// This file extracts the facts of a function used by the analyses,
+// i.e., its calls, memory accesses, branches and CFG, into flat
+// arrays, which are built once and shared by all passes.
+//
+//===-----------------------------------------------------------===//
+
+#include <llvm/IR/CFG.h>
+
+#include "FuncFacts.h"
+#include "Analyzer.h"
+
+void FuncFacts::extract(Function *F) {
+
+	addBlocks(F);
+	for (BasicBlock *BB : Blocks) {
+		for (Instruction &I : *BB)
+			addInst(&I);
+	}
+	buildCFG();
+}
+
+void FuncFacts::addBlocks(Function *F) {
+
+	// Number the blocks first, as instructions refer to them
+	for (BasicBlock &BB : *F) {
+		BlockIDs[&BB] = Blocks.size();
+		Blocks.push_back(&BB);
+	}
+}
+
+void FuncFacts::addInst(Instruction *I) {
+
+	auto addMemAccess = [this](Instruction *I, Value *Ptr,
+			MemAccessKind Kind) {
+		auto It = PointerIDs.insert(make_pair(Ptr, Pointers.size()));
+		if (It.second)
+			Pointers.push_back(Ptr);
+		MemAccesses.push_back({I, It.first->second, Kind});
+	};
+
+	if (LoadInst *LI = dyn_cast<LoadInst>(I))
+		addMemAccess(LI, LI->getPointerOperand(), MA_LOAD);
+	else if (StoreInst *SI = dyn_cast<StoreInst>(I))
+		addMemAccess(SI, SI->getPointerOperand(), MA_STORE);
+	else if (CallInst *CI = dyn_cast<CallInst>(I)) {
+		Calls.push_back({CI, CI->getCalledFunction()});
+		for (unsigned j = 0, ej = CI->getNumArgOperands();
+				j < ej; ++j) {
+			Value *Arg = CI->getArgOperand(j);
+			if (Arg->getType()->isPointerTy())
+				addMemAccess(CI, Arg, MA_CALL_ARG);
+		}
+	}
+	else if (CastInst *CastI = dyn_cast<CastInst>(I))
+		Casts.push_back(CastI);
+	else if (ReturnInst *RI = dyn_cast<ReturnInst>(I))
+		Returns.push_back(RI);
+	else if (isa<BranchInst>(I) || isa<SwitchInst>(I)) {
+		if (I->getNumSuccessors() > 1)
+			CondInsts.push_back(I);
+	}
+	else if (isa<SelectInst>(I))
+		CondInsts.push_back(I);
+}
+
+void FuncFacts::buildCFG() {
+
+	// Successors, and then predecessors from them
+	vector<unsigned> NumPreds(Blocks.size() + 1, 0);
+	SuccBegin.reserve(Blocks.size() + 1);
+	for (BasicBlock *BB : Blocks) {
+		SuccBegin.push_back(SuccIDs.size());
+		for (BasicBlock *Succ : successors(BB)) {
+			unsigned SuccID = BlockIDs[Succ];
+			SuccIDs.push_back(SuccID);
+			++NumPreds[SuccID + 1];
+		}
+	}
+	SuccBegin.push_back(SuccIDs.size());
+
+	PredBegin.resize(Blocks.size() + 1, 0);
+	for (unsigned B = 0; B < Blocks.size(); ++B)
+		PredBegin[B + 1] = PredBegin[B] + NumPreds[B + 1];
+	PredIDs.resize(SuccIDs.size());
+	vector<unsigned> Next(PredBegin.begin(), PredBegin.end() - 1);
+	for (unsigned B = 0; B < Blocks.size(); ++B) {
+		for (unsigned s = SuccBegin[B]; s < SuccBegin[B + 1]; ++s)
+			PredIDs[Next[SuccIDs[s]]++] = B;
+	}
+}
+
+void FuncFacts::collectReachBlocks(BasicBlock *BB, bool Forward,
+		set<BasicBlock *> &ReachBBs) const {
+
+	auto It = BlockIDs.find(BB);
+	if (It == BlockIDs.end())
+		return;
+
+	const vector<unsigned> &Begin = Forward ? SuccBegin : PredBegin;
+	const vector<unsigned> &IDs = Forward ? SuccIDs : PredIDs;
+
+	// Blocks already in the set are not expanded, as with the
+	// recursive traversal this replaces
+	vector<unsigned> Worklist(1, It->second);
+	while (!Worklist.empty()) {
+		unsigned B = Worklist.back();
+		Worklist.pop_back();
+		if (!ReachBBs.insert(Blocks[B]).second)
+			continue;
+		for (unsigned i = Begin[B]; i < Begin[B + 1]; ++i)
+			Worklist.push_back(IDs[i]);
+	}
+}
+
+const FuncFacts &GlobalContext::getFuncFacts(Function *F) {
+
+	// Bodies not materialized yet have no facts to keep
+	static const FuncFacts EmptyFacts;
+	if (F->isDeclaration() || F->isMaterializable())
+		return EmptyFacts;
+
+	{
+		lock_guard<mutex> Guard(FuncFactsLock);
+		auto It = FuncFactsMap.find(F);
+		if (It != FuncFactsMap.end())
+			return *It->second;
+	}
+
+	// Extract without the lock, as functions are analyzed in parallel
+	unique_ptr<FuncFacts> FF(new FuncFacts());
+	FF->extract(F);
+
+	lock_guard<mutex> Guard(FuncFactsLock);
+	auto It = FuncFactsMap.insert(make_pair(F, move(FF)));
+	return *It.first->second;
+}
+
+void InstScanner::addHandler(unsigned Opcode, InstHandler H) {
+
+	if (OpcodeHandlers.size() <= Opcode)
+		OpcodeHandlers.resize(Opcode + 1);
+	OpcodeHandlers[Opcode].push_back(H);
+}
+
+void InstScanner::addHandler(InstHandler H) {
+	AllHandlers.push_back(H);
+}
+
+void InstScanner::scan(Module *M) {
+
+	for (Function &F : *M) {
+		if (!F.isDeclaration() && !F.isMaterializable())
+			scan(&F);
+	}
+}
+
+void InstScanner::scan(Function *F) {
+
+	unique_ptr<FuncFacts> FF(new FuncFacts());
+	FF->addBlocks(F);
+	for (BasicBlock *BB : FF->Blocks) {
+		for (Instruction &Inst : *BB) {
+			Instruction *I = &Inst;
+			FF->addInst(I);
+			for (InstHandler &H : AllHandlers)
+				H(I);
+			unsigned Opcode = I->getOpcode();
+			if (Opcode < OpcodeHandlers.size()) {
+				for (InstHandler &H : OpcodeHandlers[Opcode])
+					H(I);
+			}
+		}
+	}
+	FF->buildCFG();
+
+	lock_guard<mutex> Guard(Ctx->FuncFactsLock);
+	Ctx->FuncFactsMap.insert(make_pair(F, move(FF)));
+}
@@ -0,0 +1,111 @@
+#ifndef FUNC_FACTS_H
+#define FUNC_FACTS_H
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/ADT/DenseMap.h>
+
+#include <functional>
+#include <map>
+#include <set>
+
+#include "Common.h"
+
+// A call site and its direct callee, which is NULL for indirect calls
+// and inline assembly. Callees of indirect calls are resolved by the
+// call-graph pass into GlobalContext::Callees.
+struct CallFact {
+	CallInst *CI;
+	Function *Callee;
+};
+
+// A pointer loaded from, stored to, or passed to a call
+enum MemAccessKind {
+	MA_LOAD,
+	MA_STORE,
+	MA_CALL_ARG,
+};
+
+struct MemFact {
+	Instruction *I;
+	// Index of the pointer in FuncFacts::Pointers
+	unsigned PtrID;
+	MemAccessKind Kind;
+};
+
+//
+// Facts of a function extracted by a single scan of its instructions,
+// kept in flat arrays in instruction order, so that analyses iterate
+// them instead of the instruction lists and use lists of the IR.
+//
+struct FuncFacts {
+
+	vector<CallFact> Calls;
+	vector<MemFact> MemAccesses;
+	vector<ReturnInst *> Returns;
+	vector<CastInst *> Casts;
+	// Branches and switches with more than one successor, and selects
+	vector<Instruction *> CondInsts;
+
+	// Distinct pointers of memory accesses, indexed by their IDs
+	vector<Value *> Pointers;
+	DenseMap<Value *, unsigned> PointerIDs;
+
+	// CFG of the blocks indexed by their IDs, in CSR form: the
+	// successors of block B are SuccIDs[SuccBegin[B]..SuccBegin[B+1]]
+	// and likewise for the predecessors
+	vector<BasicBlock *> Blocks;
+	DenseMap<BasicBlock *, unsigned> BlockIDs;
+	vector<unsigned> SuccBegin, SuccIDs;
+	vector<unsigned> PredBegin, PredIDs;
+
+	// ID of the pointer, or -1 if it is not accessed
+	int getPointerID(Value *V) const {
+		auto It = PointerIDs.find(V);
+		return It == PointerIDs.end() ? -1 : (int)It->second;
+	}
+
+	void extract(Function *F);
+
+	// Steps of the extraction: number the blocks, add each
+	// instruction in order, and then build the CFG
+	void addBlocks(Function *F);
+	void addInst(Instruction *I);
+	void buildCFG();
+
+	// Blocks reachable from BB, including BB, forward or backward
+	void collectReachBlocks(BasicBlock *BB, bool Forward,
+			set<BasicBlock *> &ReachBBs) const;
+};
+
+struct GlobalContext;
+
+//
+// Fused scan of the instructions of functions. Passes register
+// handlers of the opcodes they are interested in, and each function
+// is traversed once for all of them, also extracting its facts for
+// the later passes.
+//
+class InstScanner {
+
+	public:
+		typedef function<void(Instruction *)> InstHandler;
+
+		InstScanner(GlobalContext *Ctx_) : Ctx(Ctx_) {}
+
+		// Handle the instructions of the opcode
+		void addHandler(unsigned Opcode, InstHandler H);
+		// Handle all instructions
+		void addHandler(InstHandler H);
+
+		// Scan the defined functions of the module
+		void scan(Module *M);
+		void scan(Function *F);
+
+	private:
+		GlobalContext *Ctx;
+		vector<vector<InstHandler>> OpcodeHandlers;
+		vector<InstHandler> AllHandlers;
+};
+
+#endif
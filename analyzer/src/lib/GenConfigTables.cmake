@@ -0,0 +1,84 @@
+# Generate compiled-in tables of modeled functions from configs/.
+#
+# Usage: cmake -DCONFIG_DIR=<configs> -DOUTPUT=<ConfigTables.inc> -P GenConfigTables.cmake
+#
+# configs/err-funcs:   <name>
+# configs/copy-funcs:  <name> <src_arg#> <dst_arg#> <size_arg#>
+# configs/fetch-funcs: <name> <dst_arg#> <src_arg#>
+# configs/skip-funcs:  "<name>", "<name>", ...
+#
+# Lines starting with '#' are comments. Names are sorted and
+# deduplicated, so the tables can also be binary-searched.
+
+function(read_config_lines FILE VAR)
+	file(STRINGS ${FILE} LINES)
+	set(RESULT "")
+	foreach(LINE ${LINES})
+		string(LENGTH "${LINE}" LEN)
+		if(LEN LESS 2 OR LINE MATCHES "^#")
+			continue()
+		endif()
+		# Keep the name intact; it may contain tabs, see err-funcs
+		string(REPLACE "\\" "\\\\" LINE "${LINE}")
+		string(REPLACE "\"" "\\\"" LINE "${LINE}")
+		string(REPLACE "\t" "\\t" LINE "${LINE}")
+		list(APPEND RESULT "${LINE}")
+	endforeach()
+	list(REMOVE_DUPLICATES RESULT)
+	list(SORT RESULT)
+	set(${VAR} "${RESULT}" PARENT_SCOPE)
+endfunction()
+
+set(OUT "// Generated by GenConfigTables.cmake from configs/; do not edit.\n\n")
+
+# Error-handling functions
+read_config_lines(${CONFIG_DIR}/err-funcs ERR_FUNCS)
+set(OUT "${OUT}static constexpr const char *GenErrorHandleFuncs[] = {\n")
+foreach(NAME ${ERR_FUNCS})
+	set(OUT "${OUT}\t\"${NAME}\",\n")
+endforeach()
+set(OUT "${OUT}};\n\n")
+
+# Copy functions
+read_config_lines(${CONFIG_DIR}/copy-funcs COPY_FUNCS)
+set(OUT "${OUT}struct GenCopyFunc {\n\tconst char *Name;\n\tint8_t Src, Dst, Size;\n};\n")
+set(OUT "${OUT}static constexpr GenCopyFunc GenCopyFuncs[] = {\n")
+foreach(LINE ${COPY_FUNCS})
+	if(NOT LINE MATCHES "^([^ ]+) +(-?[0-9]+) +(-?[0-9]+) +(-?[0-9]+) *$")
+		message(FATAL_ERROR "Malformed line in copy-funcs: ${LINE}")
+	endif()
+	set(OUT "${OUT}\t{\"${CMAKE_MATCH_1}\", ${CMAKE_MATCH_2}, ${CMAKE_MATCH_3}, ${CMAKE_MATCH_4}},\n")
+endforeach()
+set(OUT "${OUT}};\n\n")
+
+# Data-fetch functions
+read_config_lines(${CONFIG_DIR}/fetch-funcs FETCH_FUNCS)
+set(OUT "${OUT}struct GenDataFetchFunc {\n\tconst char *Name;\n\tint8_t Dst, Src;\n};\n")
+set(OUT "${OUT}static constexpr GenDataFetchFunc GenDataFetchFuncs[] = {\n")
+foreach(LINE ${FETCH_FUNCS})
+	if(NOT LINE MATCHES "^([^ ]+) +(-?[0-9]+) +(-?[0-9]+) *$")
+		message(FATAL_ERROR "Malformed line in fetch-funcs: ${LINE}")
+	endif()
+	set(OUT "${OUT}\t{\"${CMAKE_MATCH_1}\", ${CMAKE_MATCH_2}, ${CMAKE_MATCH_3}},\n")
+endforeach()
+set(OUT "${OUT}};\n\n")
+
+# Uninteresting functions whose call sites are skipped
+file(READ ${CONFIG_DIR}/skip-funcs SKIP_TEXT)
+string(REGEX MATCHALL "\"[^\"]+\"" SKIP_FUNCS "${SKIP_TEXT}")
+list(REMOVE_DUPLICATES SKIP_FUNCS)
+list(SORT SKIP_FUNCS)
+set(OUT "${OUT}static constexpr const char *GenSkipFuncs[] = {\n")
+foreach(NAME ${SKIP_FUNCS})
+	set(OUT "${OUT}\t${NAME},\n")
+endforeach()
+set(OUT "${OUT}};\n")
+
+# Only touch the output when it changes to avoid needless rebuilds
+if(EXISTS ${OUTPUT})
+	file(READ ${OUTPUT} OLD)
+	if(OLD STREQUAL OUT)
+		return()
+	endif()
+endif()
+file(WRITE ${OUTPUT} "${OUT}")
@@ -8,10 +8,16 @@
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/Value.h>
 #include <llvm/IR/CFG.h>
+#include <llvm/ADT/DenseSet.h>
 
 #include "MissingChecks.h"
+#include "ReportWriter.h"
 #include "Config.h"
 
+#include <cmath>
+#include <iomanip>
+#include <random>
+
 
 ////////////////////////////////////////////////////////////
 //
@@ -25,6 +31,23 @@
 #define REPORT_SRC
 #define REPORT_USE
 
+// Defaults of the report options, see MCReportOptions
+//#define MC_ADDRTAKEN_FUNC_ONLY
+
+// Sources and uses with higher uncheck ratings are not reported
+#define SRC_RATING_THRESHOLD 0.3
+#define USE_RATING_THRESHOLD 0.1
+
+// With -sample-stage2, stage 2 first slices a sample of the call
+// sites of each callee, and slices the others only for sources and
+// uses that may still be reported, see pruneSampled()
+#define SAMPLE_SITES 32
+// z-score of the confidence bound of sampled uncheck ratios (99%)
+#define SAMPLE_CONFIDENCE_Z 2.576
+// With a deadline, share of the time left for identifying and counting
+// checks in stage 1; the rest is left to stage 2
+#define STAGE1_TIME_SHARE 0.5
+
 const string test_funcs[] = {
 	"dccp_v6_send_response",
 	"free_pmd_range",
@@ -67,23 +90,31 @@ using namespace std;
 // Initialize the static variables
 //
 int MissingChecksPass::AnalysisStage = 1;
-map<src_t, unsigned> MissingChecksPass::SrcCheckCount;
-map<use_t, unsigned> MissingChecksPass::UseCheckCount;
-
-map<src_t, unsigned> MissingChecksPass::SrcUncheckCount;
-map<use_t, unsigned> MissingChecksPass::UseUncheckCount;
-
-map<src_t, unsigned> MissingChecksPass::SrcTotalCount;
-map<use_t, unsigned> MissingChecksPass::UseTotalCount;
-
-set<src_t> MissingChecksPass::CheckedSrcSet;
-set<use_t> MissingChecksPass::CheckedUseSet;
-
-map<src_t, set<Value *>> MissingChecksPass::SrcUnchecksMap;
-map<use_t, set<Value *>> MissingChecksPass::UseUnchecksMap;
-
-map<src_t, set<ModelSC>> MissingChecksPass::SrcChecksMap;
-map<use_t, set<ModelSC>> MissingChecksPass::UseChecksMap;
+SrcUseStatTable MissingChecksPass::SrcStats;
+SrcUseStatTable MissingChecksPass::UseStats;
+vector<CoreStat> MissingChecksPass::CoreStats;
+MCReportOptions MissingChecksPass::ReportOpts = {
+	SRC_RATING_THRESHOLD,
+	USE_RATING_THRESHOLD,
+#ifdef MC_ADDRTAKEN_FUNC_ONLY
+	true,
+#else
+	false,
+#endif
+#ifdef REPORT_SRC
+	true,
+#else
+	false,
+#endif
+#ifdef REPORT_USE
+	true,
+#else
+	false,
+#endif
+	RF_TEXT,
+	"",
+	false,
+};
 
 set<Value *> MissingChecksPass::TrackedSrcSet;
 set<Value *> MissingChecksPass::TrackedUseSet;
@@ -93,6 +124,11 @@ set<Value *> MissingChecksPass::TrackedUseSet;
 // Implementation of MissingCheckPass
 //
 
+/// Uninteresting callees, see configs/skip-funcs
+bool MissingChecksPass::isSkippedCallee(Function *CF) {
+	return Ctx->ModeledFuncs.getRoles(CF) & FR_SKIP;
+}
+
 /// Alias analysis
 void MissingChecksPass::collectAliasPointers(Function *F, LoadInst
 		*LI, set <Value *> &AliasSet) {
@@ -102,11 +138,13 @@ void MissingChecksPass::collectAliasPointers(Function *F, LoadInst
 	if (!AI)
 		return;
 
-	for (inst_iterator i = inst_begin(F), ei = inst_end(F); i != ei; ++i) {
-		StoreInst *SI = dyn_cast<StoreInst>(&*i);
-		if (!SI) 
+	const FuncFacts &FF = Ctx->getFuncFacts(F);
+	int PtrID = FF.getPointerID(LPO);
+	for (const MemFact &MF : FF.MemAccesses) {
+		if (MF.Kind != MA_STORE || (int)MF.PtrID != PtrID)
 			continue;
-		if (SI->getPointerOperand() == LPO && DFA.possibleUseStResult(LI, SI))
+		StoreInst *SI = cast<StoreInst>(MF.I);
+		if (DFA.possibleUseStResult(LI, SI))
 			AliasSet.insert(SI->getValueOperand());
 	}
 }
@@ -164,7 +202,7 @@ void MissingChecksPass::findSourceCV(Value *V, set<Value *> &CVSet,
 		std::set<Value *> AliasSet;
 
 		DFA.getAliasPointers(LI->getPointerOperand(), AliasSet,
-				Ctx->FuncPAResults[F]);
+				Ctx->getPAResults(F));
 
 		set<BasicBlock *> reachBBs;
 		DFA.collectPredReachBlocks(LI->getParent(), reachBBs);
@@ -467,7 +505,7 @@ void MissingChecksPass::isCheckedBackward(Function *F, use_t Use,
 
 		set<Value *> AliasSet;
 		DFA.getAliasPointers(LI->getPointerOperand(), AliasSet,
-				Ctx->FuncPAResults[F]);
+				Ctx->getPAResults(F));
 
 		for (Value *A : AliasSet) {
 			for (User *SU : A->users()) {
@@ -601,7 +639,7 @@ void MissingChecksPass::isCheckedForward(Function *F, src_t Src,
 		if (SI && V == SI->getValueOperand()) {
 			std::set<Value *> AliasSet;
 			DFA.getAliasPointers(SI->getPointerOperand(), AliasSet,
-					Ctx->FuncPAResults[F]);
+					Ctx->getPAResults(F));
 			for (Value *A : AliasSet) {
 				for (User *SU : A->users()) {
 					LoadInst *LI = dyn_cast<LoadInst>(SU);
@@ -696,27 +734,29 @@ ModelSC MissingChecksPass::modelCheck(CmpInst *CmpI,
 }
 
 void MissingChecksPass::addSrcCheck(src_t Src, ModelSC MSC) {
-	SrcCheckCount[Src] += 1;
-	CheckedSrcSet.insert(Src);
-	SrcChecksMap[Src].insert(MSC);
+	SrcUseStat &SS = SrcStats.get(Src);
+	SS.CheckCount += 1;
+	SS.Checks.insert(MSC);
 }
 
 void MissingChecksPass::addUseCheck(use_t Use, ModelSC MSC) {
-	UseCheckCount[Use] += 1;
-	CheckedUseSet.insert(Use);
-	UseChecksMap[Use].insert(MSC);
+	SrcUseStat &US = UseStats.get(Use);
+	US.CheckCount += 1;
+	US.Checks.insert(MSC);
 }
 
 void MissingChecksPass::addSrcUncheck(src_t Src,
 		Value *V) {
-	SrcUncheckCount[Src] += 1;
-	SrcUnchecksMap[Src].insert(V);
+	SrcUseStat &SS = SrcStats.get(Src);
+	SS.UncheckCount += 1;
+	SS.Unchecks.insert(V);
 }
 
 void MissingChecksPass::addUseUncheck(use_t Use, 
 		Value *V) {
-	UseUncheckCount[Use] += 1;
-	UseUnchecksMap[Use].insert(V);
+	SrcUseStat &US = UseStats.get(Use);
+	US.UncheckCount += 1;
+	US.Unchecks.insert(V);
 }
 
 bool MissingChecksPass::inModeledCheckSet(CmpInst *CmpI,
@@ -724,20 +764,10 @@ bool MissingChecksPass::inModeledCheckSet(CmpInst *CmpI,
 
 	ModelSC MSC = modelCheck(CmpI, SrcUse, ArgNo);
 
-	if (IsSrc) {
-		src_t Src = src_c(SrcUse, ArgNo);
-		if (SrcChecksMap[Src].find(MSC) 
-				!= SrcChecksMap[Src].end()) {
-			return true;
-		}
-	}
-	else {
-		use_t Use = use_c(SrcUse, ArgNo);
-		if (UseChecksMap[Use].find(MSC) 
-				!= UseChecksMap[Use].end()) {
-			return true;
-		}
-	}
+	SrcUseStat *SUS = IsSrc ? SrcStats.find(src_c(SrcUse, ArgNo))
+		: UseStats.find(use_c(SrcUse, ArgNo));
+	if (SUS && SUS->Checks.find(MSC) != SUS->Checks.end())
+		return true;
 	return false;
 }
 
@@ -807,7 +837,7 @@ void MissingChecksPass::countSrcUseChecks(Function *F,
 
 			if (Ctx->Callees[CI].size())
 				CF = *(Ctx->Callees[CI].begin());
-			if (!CF) continue;
+			if (!CF || isSkippedCallee(CF)) continue;
 
 			src_t Src = src_c(CF, -1);
 			addSrcCheck(Src, modelCheck(dyn_cast<CmpInst>(SCI),
@@ -837,7 +867,7 @@ void MissingChecksPass::countSrcUseChecks(Function *F,
 
 					if (Ctx->Callees[CI].size())
 						CF = *(Ctx->Callees[CI].begin());
-					if (!CF) continue;
+					if (!CF || isSkippedCallee(CF)) continue;
 
 					src_t Src = src_c(CF, ArgNo);
 					addSrcCheck(Src, modelCheck(dyn_cast<CmpInst>(SCI),
@@ -880,7 +910,7 @@ void MissingChecksPass::countSrcUseChecks(Function *F,
 
 					if (Ctx->Callees[CI].size())
 						CF = *(Ctx->Callees[CI].begin());
-					if (!CF) continue;
+					if (!CF || isSkippedCallee(CF)) continue;
 
 					use_t PUse = use_c(CF, Use.second);
 					addUseCheck(PUse, modelCheck(dyn_cast<CmpInst>(SCI),
@@ -891,23 +921,156 @@ void MissingChecksPass::countSrcUseChecks(Function *F,
 	}
 }
 
+// Upper bound of the total count of a source or use: the number of
+// call sites of a function, or of callees of an indirect call
+unsigned MissingChecksPass::countCallSites(Value *V) {
+
+	if (CallInst *CI = dyn_cast<CallInst>(V))
+		return Ctx->Callees[CI].size();
+	if (Function *F = dyn_cast<Function>(V)) {
+		auto It = Ctx->Callers.find(F);
+		unsigned NumSites = It == Ctx->Callers.end() ? 0 : It->second.size();
+		// Call sites in the core kernel, which is not loaded
+		if (!Ctx->CoreCallSites.empty() && F->isDeclaration())
+			NumSites += Ctx->CoreCallSites.lookup(F->getName());
+		return NumSites;
+	}
+	return UINT_MAX;
+}
+
+// With at least one uncheck, the rating of a source or use is at
+// least 1 / min(#call sites, #checks + 1), see processResults()
+bool MissingChecksPass::isSupported(SrcUseStat &SUS, double Threshold) {
+
+	unsigned MaxTotal = min(countCallSites(SUS.Key.first),
+			SUS.CheckCount + 1);
+	return MaxTotal && (float)1/MaxTotal <= Threshold;
+}
+
+// Drop the sources and uses that can never be reported before
+// slicing their call sites in stage 2
+void MissingChecksPass::pruneUnsupported() {
+
+#ifndef UNIT_TEST
+	size_t NumSrcs = SrcStats.size(), NumUses = UseStats.size();
+	SrcStats.removeIf([&](SrcUseStat &SS) {
+			return !isSupported(SS, ReportOpts.SrcThreshold); });
+	UseStats.removeIf([&](SrcUseStat &US) {
+			return !isSupported(US, ReportOpts.UseThreshold); });
+	OP<<"## Pruned "<<NumSrcs - SrcStats.size()<<" / "<<NumSrcs
+		<<" sources and "<<NumUses - UseStats.size()<<" / "<<NumUses
+		<<" uses without enough support\n";
+#endif
+}
+
+// Index the call sites of checked sources and uses by their callers,
+// so that stage 2 need not scan all instructions. When sampling, only
+// a random sample of the direct call sites of each callee is indexed,
+// and the others are kept for the verification round.
+void MissingChecksPass::collectUncheckSites(bool Sampling) {
+
+	UncheckSites.clear();
+	DenseSet<CallInst *> VisitedSites;
+	DenseSet<Value *> VisitedCallees;
+	mt19937 RNG(0);
+	auto addSite = [&](CallInst *CI) {
+		if (VisitedSites.insert(CI).second)
+			UncheckSites[CI->getFunction()].push_back(CI);
+	};
+	auto addCallee = [&](Value *V) {
+		// Arguments of indirect calls as sources
+		if (CallInst *CI = dyn_cast<CallInst>(V)) {
+			if (Sampling)
+				addSite(CI);
+			return;
+		}
+		Function *CF = dyn_cast<Function>(V);
+		if (!CF || !VisitedCallees.insert(CF).second)
+			return;
+
+		if (!Sampling) {
+			for (CallInst *CI : UnsampledSites[CF])
+				addSite(CI);
+			return;
+		}
+		vector<CallInst *> Sites;
+		for (CallInst *CI : Ctx->Callers[CF]) {
+			if (!CallSite(CI).isIndirectCall())
+				Sites.push_back(CI);
+		}
+		if (SampledStage2 && !KeepAll && Sites.size() > SAMPLE_SITES) {
+			std::shuffle(Sites.begin(), Sites.end(), RNG);
+			UnsampledSites[CF].assign(Sites.begin() + SAMPLE_SITES, Sites.end());
+			Sites.resize(SAMPLE_SITES);
+		}
+		for (CallInst *CI : Sites)
+			addSite(CI);
+	};
+
+	for (SrcUseStat &SS : SrcStats)
+		addCallee(SS.Key.first);
+	for (SrcUseStat &US : UseStats)
+		addCallee(US.Key.first);
+}
+
+// Lower confidence bound (Wilson score) of an uncheck ratio, given
+// the unchecks in a sample of call sites. If all call sites are
+// sampled, the ratio is exact.
+static double uncheckRatioLowerBound(unsigned Unchecks, unsigned Samples,
+		bool Exhaustive) {
+
+	if (!Samples)
+		return 0;
+	double P = (double)Unchecks/Samples;
+	if (Exhaustive)
+		return P;
+
+	double Z = SAMPLE_CONFIDENCE_Z, N = Samples;
+	double Center = P + Z*Z/(2*N);
+	double Margin = Z*sqrt(P*(1 - P)/N + Z*Z/(4*N*N));
+	return (Center - Margin)/(1 + Z*Z/N);
+}
+
+// After the sampling round of stage 2, drop the sources and uses
+// whose ratio of unchecks is confidently above the threshold: as
+// Total bounds the rating denominator, the rating is at least that
+// ratio. Only the others are verified with all call sites.
+void MissingChecksPass::pruneSampled() {
+
+#ifndef UNIT_TEST
+	size_t NumSrcs = SrcStats.size(), NumUses = UseStats.size();
+	auto isUnchecked = [&](SrcUseStat &SUS, double Threshold) {
+		bool Exhaustive = !isa<Function>(SUS.Key.first)
+			|| UnsampledSites.find(SUS.Key.first) == UnsampledSites.end();
+		return uncheckRatioLowerBound(SUS.UncheckCount,
+				SUS.TotalCount, Exhaustive) > Threshold;
+	};
+	SrcStats.removeIf([&](SrcUseStat &SS) {
+			return isUnchecked(SS, ReportOpts.SrcThreshold); });
+	UseStats.removeIf([&](SrcUseStat &US) {
+			return isUnchecked(US, ReportOpts.UseThreshold); });
+	OP<<"## Pruned "<<NumSrcs - SrcStats.size()<<" / "<<NumSrcs
+		<<" sources and "<<NumUses - UseStats.size()<<" / "<<NumUses
+		<<" uses with sampled unchecks\n";
+#endif
+}
+
 void MissingChecksPass::countSrcUseUnchecks(Function *F) {
 
-	// Do unchecks counting
-	for (inst_iterator i = inst_begin(F), e = inst_end(F); 
-			i != e; ++i) {
+	auto Sites = UncheckSites.find(F);
+	if (Sites == UncheckSites.end())
+		return;
 
-		CallInst *CI = dyn_cast<CallInst>(&*i);
-		if (!CI)
-			continue;
+	// Do unchecks counting
+	for (CallInst *CI : Sites->second) {
 
 		CallSite CS(CI);
 		// Source
 		// Argument as a source
 		if (CS.isIndirectCall()) {
 			for (int8_t ArgNo = 0; ArgNo < CI->getNumArgOperands(); ++ArgNo) {
-				auto Src = CheckedSrcSet.find(src_c(CI, ArgNo));
-				if (Src == CheckedSrcSet.end())
+				SrcUseStat *SS = SrcStats.find(src_c(CI, ArgNo));
+				if (!SS)
 					continue;
 				for (auto Callee : Ctx->Callees[CI]) {
 
@@ -929,7 +1092,7 @@ void MissingChecksPass::countSrcUseUnchecks(Function *F) {
 						set<Value *> AliasSet;
 						// A check may target loaded variables
 						DFA.getAliasPointers(PArg, AliasSet,
-								Ctx->FuncPAResults[Callee]);
+								Ctx->getPAResults(Callee));
 						for (Value *A : AliasSet) {
 							for (User *U : A->users()) {
 								LoadInst *LI = dyn_cast<LoadInst>(U);
@@ -943,16 +1106,16 @@ void MissingChecksPass::countSrcUseUnchecks(Function *F) {
 					}
 					// Check each slice to see if it is ever checked
 					for (Value *TV : ToTrackSet) {
-						isCheckedForward(F, *Src, TV, 
+						isCheckedForward(F, SS->Key, TV, 
 								reachBBs, VSet, isChecked, Depth);
 						if (isChecked)
 							break;
 					}
 
 					if (!isChecked) {
-						addSrcUncheck(*Src, PArg);
+						addSrcUncheck(SS->Key, PArg);
 					}
-					SrcTotalCount[*Src] += 1;
+					SS->TotalCount += 1;
 				}
 			}
 			continue;
@@ -972,15 +1135,8 @@ void MissingChecksPass::countSrcUseUnchecks(Function *F) {
 		if (Ctx->Callees[CI].size())
 			CF = *(Ctx->Callees[CI].begin());
 		if (CF) {
-			// Skip the functions in the blacklist
-			// TODO: move these functions to Config.h or a file
-			if (CF->getName() == "outb"
-					|| CF->getName() == "__const_udelay" 
-					|| CF->getName() == "__udelay" 
-					|| CF->getName() == "scnprintf" 
-					|| CF->getName() == "__fswab16" 
-					|| CF->getName() == "__fswab32" 
-			   )
+			// Skip the functions in configs/skip-funcs
+			if (isSkippedCallee(CF))
 				continue;
 
 			int8_t ArgNo = -2;
@@ -1006,10 +1162,10 @@ void MissingChecksPass::countSrcUseUnchecks(Function *F) {
 					}
 				}
 
-				auto Src = CheckedSrcSet.find(src_c(CF, ArgNo));
+				SrcUseStat *SS = SrcStats.find(src_c(CF, ArgNo));
 
 				// Skip cases with only one check
-				if (Src != CheckedSrcSet.end()) {
+				if (SS) {
 					// Do forward slicing and see if CI is ever checked
 					bool isChecked = false;
 					set<Value*> VSet = {};
@@ -1029,7 +1185,7 @@ void MissingChecksPass::countSrcUseUnchecks(Function *F) {
 						set<Value *> AliasSet;
 						set<Value *> ToTrackSet;
 						DFA.getAliasPointers(Param, AliasSet,
-								Ctx->FuncPAResults[F]);
+								Ctx->getPAResults(F));
 						for (Value *A : AliasSet) {
 							for (User *U : A->users()) {
 								LoadInst *LI = dyn_cast<LoadInst>(U);
@@ -1041,7 +1197,7 @@ void MissingChecksPass::countSrcUseUnchecks(Function *F) {
 							}
 						}
 						for (Value *TV : ToTrackSet) {
-							isCheckedForward(F, *Src, TV, 
+							isCheckedForward(F, SS->Key, TV, 
 									reachBBs, VSet, isChecked, Depth);
 							if (isChecked)
 								break;
@@ -1050,9 +1206,9 @@ void MissingChecksPass::countSrcUseUnchecks(Function *F) {
 
 					if (!isChecked) {
 						//TODO: resolve the IS_ERR() issue
-						addSrcUncheck(*Src, CI);
+						addSrcUncheck(SS->Key, CI);
 					}
-					SrcTotalCount[*Src] += 1;
+					SS->TotalCount += 1;
 				}
 			} while ((ArgNo + 1) < CF->arg_size());
 		}
@@ -1062,7 +1218,8 @@ void MissingChecksPass::countSrcUseUnchecks(Function *F) {
 			for (int8_t ArgNo = 0; ArgNo < CI->getNumArgOperands(); ++ArgNo) {
 
 				use_t Use = use_c(CF, ArgNo);
-				if (CheckedUseSet.find(Use) != CheckedUseSet.end()) {
+				SrcUseStat *US = UseStats.find(Use);
+				if (US) {
 					Value *Arg = CI->getArgOperand(ArgNo);
 
 					// Also do backward slicing and see if Arg is
@@ -1080,204 +1237,681 @@ void MissingChecksPass::countSrcUseUnchecks(Function *F) {
 					if (!isChecked) {
 						addUseUncheck(Use, Arg);
 					}
-					UseTotalCount[Use] += 1;
+					US->TotalCount += 1;
 				}
 			}
 		}
 	}
 }
 
-void MissingChecksPass::processResults() {
+// Make the record of a source or use for reporting
+SrcUseRecord MissingChecksPass::makeRecord(SrcUseStat &SUS, bool IsSrc) {
+
+	// Keys are callees, or indirect call sites whose callers count
+	auto isAddrTaken = [&](Value *V) {
+		if (Function *F = dyn_cast<Function>(V))
+			return Ctx->AddressTakenFuncs.count(F) > 0;
+		if (CallInst *CI = dyn_cast<CallInst>(V))
+			return Ctx->AddressTakenFuncs.count(CI->getFunction()) > 0;
+		return true;
+	};
+
+	SrcUseRecord R{IsSrc, "", (int)SUS.Key.second, SUS.CheckCount,
+		SUS.UncheckCount, SUS.TotalCount, true, {}, {}, {}};
+	R.Streamed = SUS.Streamed;
+	if (!IsSrc)
+		R.AddrTaken = isAddrTaken(SUS.Key.first);
+	else if (SUS.Key.second == -1)
+		R.SrcTy = "retval";
+	else if (isa<CallInst>(SUS.Key.first))
+		R.SrcTy = "argmt";
+	else
+		R.SrcTy = "param";
+	if (R.SrcTy == "retval" || R.SrcTy == "param")
+		R.AddrTaken = isAddrTaken(SUS.Key.first);
+
+	// Code lines are fetched in batches when reported
+	SourceInfo SI;
+	if (R.SrcTy == "argmt" && getSourceInfo(SUS.Key.first, SI, false))
+		R.KeyInfo.push_back(SI);
+	for (Value *V : SUS.Unchecks) {
+		bool Found;
+		if (Argument *PArg = dyn_cast<Argument>(V))
+			Found = getSourceInfo(PArg->getParent(), SI, false);
+		else
+			Found = getSourceInfo(V, SI, false);
+		if (Found)
+			R.UncheckInfo.push_back(SI);
+	}
+	for (ModelSC MSC : SUS.Checks)
+		R.PeerChecks.push_back(make_pair(MSC.SCO, MSC.SCC));
+
+	return R;
+}
+
+// Collect the candidates of sources and uses, i.e., those with both
+// checks and unchecks, regardless of the report options. Unchecks
+// merged from a core summary are not reported again.
+void MissingChecksPass::collectRecords(vector<SrcUseRecord> &Records) {
+
+	for (SrcUseStat &SS : SrcStats) {
+		if (SS.CheckCount && !SS.Unchecks.empty())
+			Records.push_back(makeRecord(SS, true));
+	}
+	for (SrcUseStat &US : UseStats) {
+		if (US.CheckCount && !US.Unchecks.empty())
+			Records.push_back(makeRecord(US, false));
+	}
 
-	for (src_t Src : CheckedSrcSet) {
-		unsigned Checks = 0, Unchecks = 0, Total = 0;
-		float Rating = 0;
-		if (SrcCheckCount.find(Src) != SrcCheckCount.end()) {
-			Checks = SrcCheckCount[Src];
-			Total = SrcTotalCount[Src];
+	// Ratings are computed over the analyzed call sites only, unless
+	// the statistics were final before the deadline; checks cut off
+	// in stage 1 leave all of them partial
+	for (SrcUseRecord &R : Records)
+		R.Partial = ChecksPartial || (Partial && !R.Streamed);
+}
+
+// Order the functions with call sites to visit in stage 2 by the
+// expected yield, so that the most likely reports are final when the
+// deadline is reached. Callees with more peer checks have more
+// confident ratings, so call sites are weighted by the checks of
+// their callees.
+void MissingChecksPass::prioritizeUncheckSites() {
+
+	DenseMap<Value *, unsigned> CalleeChecks;
+	for (SrcUseStat &SS : SrcStats)
+		CalleeChecks[SS.Key.first] += SS.CheckCount;
+	for (SrcUseStat &US : UseStats)
+		CalleeChecks[US.Key.first] += US.CheckCount;
+
+	vector<pair<unsigned, Function *>> Priorities;
+	for (auto &Sites : UncheckSites) {
+		if (!isAnalyzed(Sites.first))
+			continue;
+		unsigned Priority = 0;
+		for (CallInst *CI : Sites.second) {
+			auto It = CalleeChecks.find(getSiteCallee(CI));
+			if (It != CalleeChecks.end())
+				Priority += It->second;
 		}
+		Priorities.push_back(make_pair(Priority, Sites.first));
+	}
 
-		if (SrcUncheckCount.find(Src) != SrcUncheckCount.end())
-			Unchecks = SrcUncheckCount[Src];
+	// Cheaper functions first among equal priorities
+	std::sort(Priorities.begin(), Priorities.end(),
+			[](const pair<unsigned, Function *> &P1,
+				const pair<unsigned, Function *> &P2) {
+			if (P1.first != P2.first)
+				return P1.first > P2.first;
+			return P1.second->size() < P2.second->size(); });
+
+	Worklist.clear();
+	for (auto &P : Priorities)
+		Worklist.push_back(P.second);
+}
 
-		if (Checks && Unchecks) {
-			if (Checks + Unchecks < Total)
-				Total = Checks + Unchecks;
-			Rating = (float)Unchecks/Total;
+// Index the checked sources and uses whose statistics are final
+// after this round of stage 2 by their callees, and count their
+// call sites to be visited
+void MissingChecksPass::collectPendingCallees() {
 
-#ifndef UNIT_TEST
-			if (Rating > 0.3)
-				continue;
-#endif
+	PendingCallees.clear();
+	auto addPending = [&](SrcUseStat &SUS) {
+		Value *V = SUS.Key.first;
+		// Unsampled call sites are visited in the next round
+		if (!Verifying && UnsampledSites.count(V))
+			return;
+		PendingCallees[V].Stats.push_back(&SUS);
+	};
+	for (SrcUseStat &SS : SrcStats)
+		addPending(SS);
+	for (SrcUseStat &US : UseStats)
+		addPending(US);
+
+	for (auto &Sites : UncheckSites) {
+		if (!isAnalyzed(Sites.first))
+			continue;
+		for (CallInst *CI : Sites.second) {
+			auto It = PendingCallees.find(getSiteCallee(CI));
+			if (It != PendingCallees.end())
+				++It->second.NumSites;
+		}
+	}
 
-#ifdef REPORT_SRC
+	// Without call sites to visit, the statistics are final already
+	for (auto &PC : PendingCallees) {
+		if (!PC.second.NumSites)
+			streamStats(PC.second);
+	}
+}
 
-			string SrcTy;
-			if (Src.second == -1)
-				SrcTy = "retval";
-			else if (isa<CallInst>(Src.first))
-				SrcTy = "argmt";
-			else
-				SrcTy = "param";
+// The callee keying the statistics that a call site counts for, see
+// countSrcUseUnchecks()
+Value *MissingChecksPass::getSiteCallee(CallInst *CI) {
 
-#ifdef MC_ADDRTAKEN_FUNC_ONLY
-			// 
-			// Only consider address-taken functions?
-			// 
-			Instruction *SrcI = dyn_cast<Instruction>(Src.first);
-			if (SrcI && (SrcTy == "retval" || SrcTy == "param")) {
-				if (Ctx->AddressTakenFuncs.find(SrcI->getParent()->getParent())
-						== Ctx->AddressTakenFuncs.end())
-					continue;
-			}
-#endif
-			OP<<format("== [Src-%s]: Rating: %.3f, Checks: %d, Unchecks: %d, Total: %d | Arg: %d\n",
-					SrcTy.c_str(), Rating, Checks, Unchecks, Total, (int)Src.second);
+	if (CallSite(CI).isIndirectCall())
+		return CI;
+	auto It = Ctx->Callees.find(CI);
+	if (It == Ctx->Callees.end() || It->second.empty())
+		return NULL;
+	return *It->second.begin();
+}
 
-			if (SrcTy == "argmt") {
-				printSourceCodeInfo(Src.first);
+// Report the statistics of a callee, as all its call sites have been
+// visited
+void MissingChecksPass::streamStats(PendingCallee &PC) {
 
-				OP<<"\n\tUnchecks:";
-			}
+	for (SrcUseStat *SUS : PC.Stats) {
+		if (SUS->Streamed)
+			continue;
+		SUS->Streamed = true;
+		if (!SUS->CheckCount || SUS->Unchecks.empty())
+			continue;
 
-			for (Value *V : SrcUnchecksMap[Src]) {
-				OP<<"\t"<<"\n";
-				if (Argument *PArg = dyn_cast<Argument>(V)) {
-					printSourceCodeInfo(PArg->getParent());
-				}
-				else
-					printSourceCodeInfo(V);
+		SrcUseRecord R = makeRecord(*SUS, SrcStats.find(SUS->Key) == SUS);
+		R.Partial = ChecksPartial;
+		if (isReported(R))
+			StreamWriter->add(move(R));
+	}
+}
 
-			}
+// Report the statistics finalized by visiting the call sites in F
+void MissingChecksPass::streamFinalized(Function *F) {
 
-			// Print peer functions
-			if (SrcTy == "argmt") {
-				OP<<"\n\tPeer checks:\n";
-				int count = 0;
-				for (ModelSC MSC : SrcChecksMap[Src]) {
-					++count;
-					if (count == 10)
-						break;
-					//if (Function *CF = dyn_cast<Function>(MSC.CheckedV))
-					//	printSourceCodeInfo(CF);
-				}
-			}
+	auto Sites = UncheckSites.find(F);
+	if (Sites == UncheckSites.end())
+		return;
 
-			OP<<"\n\n\n";
-#endif
-		}
+	for (CallInst *CI : Sites->second) {
+		auto It = PendingCallees.find(getSiteCallee(CI));
+		if (It == PendingCallees.end() || !It->second.NumSites)
+			continue;
+		if (--It->second.NumSites == 0)
+			streamStats(It->second);
+	}
+}
+
+//
+// Stats file format, one entry per line:
+//   T <source threshold> <use threshold>
+//   S <src type> <arg#> <checks> <unchecks> <total> <addr-taken> <partial>
+//   U <arg#> <checks> <unchecks> <total> <addr-taken> <partial>
+//   K <line#> <file> <code line>
+//   W <line#> <file> <code line>
+//   P <operator> <condition>
+// where T gives the thresholds that the statistics were pruned with,
+// and K (location of the key), W (uncheck witnesses), and P (peer
+// check models) belong to the last S or U.
+//
+bool MissingChecksPass::writeRecords(const string &StatsFile,
+		vector<SrcUseRecord> &Records) {
+
+	ofstream statsfile(StatsFile);
+	if (!statsfile.is_open())
+		return false;
+
+	statsfile << "T " << ReportOpts.SrcThreshold << " "
+		<< ReportOpts.UseThreshold << "\n";
+	auto writeSourceInfo = [&](const char *Kind, SourceInfo &SI) {
+		statsfile << Kind << " " << SI.LineNo << " " << quoted(SI.File) << " "
+			<< SI.Line << "\n";
+	};
+
+	for (SrcUseRecord &R : Records) {
+		if (R.IsSrc)
+			statsfile << "S " << R.SrcTy << " ";
+		else
+			statsfile << "U ";
+		statsfile << R.ArgNo << " " << R.CheckCount << " "
+			<< R.UncheckCount << " " << R.TotalCount << " "
+			<< R.AddrTaken << " " << R.Partial << "\n";
+
+		for (SourceInfo &SI : R.KeyInfo)
+			writeSourceInfo("K", SI);
+		for (SourceInfo &SI : R.UncheckInfo)
+			writeSourceInfo("W", SI);
+		for (auto &PC : R.PeerChecks)
+			statsfile << "P " << PC.first << " " << PC.second << "\n";
 	}
+	statsfile.close();
 
-	for (use_t Use : CheckedUseSet) {
-		unsigned Checks = 0, Unchecks = 0, Total = 0;
-		float Rating = 0;
-		if (UseCheckCount.find(Use) != UseCheckCount.end()) {
-			Checks = UseCheckCount[Use];
-			Total = UseTotalCount[Use];
+	return true;
+}
+
+bool MissingChecksPass::readRecords(const string &StatsFile,
+		vector<SrcUseRecord> &Records, double &SrcThreshold,
+		double &UseThreshold) {
+
+	ifstream statsfile(StatsFile);
+	if (!statsfile.is_open())
+		return false;
+
+	string line, kind;
+	while (getline(statsfile, line)) {
+		istringstream iss(line);
+		if (!(iss >> kind))
+			continue;
+
+		SrcUseRecord R{kind == "S", "", 0, 0, 0, 0, true, {}, {}, {}};
+		SourceInfo SI;
+		int SCO, SCC;
+		if (kind == "T") {
+			if (iss >> SrcThreshold >> UseThreshold)
+				continue;
+		}
+		else if (kind == "S" || kind == "U") {
+			if ((!R.IsSrc || iss >> R.SrcTy) && iss >> R.ArgNo
+					>> R.CheckCount >> R.UncheckCount >> R.TotalCount
+					>> R.AddrTaken) {
+				iss >> R.Partial;
+				Records.push_back(move(R));
+				continue;
+			}
+		}
+		else if ((kind == "K" || kind == "W") && Records.size()
+				&& iss >> SI.LineNo >> quoted(SI.File)) {
+			getline(iss >> ws, SI.Line);
+			if (kind == "K")
+				Records.back().KeyInfo.push_back(SI);
+			else
+				Records.back().UncheckInfo.push_back(SI);
+			continue;
+		}
+		else if (kind == "P" && Records.size() && iss >> SCO >> SCC) {
+			Records.back().PeerChecks.push_back(
+					make_pair((SCOperator)SCO, (SCCondition)SCC));
+			continue;
 		}
-		if (UseUncheckCount.find(Use) != UseUncheckCount.end())
-			Unchecks = UseUncheckCount[Use];
+		OP << "Ignoring malformed line in stats file: " << line << "\n";
+	}
+	statsfile.close();
 
-		if (Checks && Unchecks) {
-			if (Checks + Unchecks < Total)
-				Total = Checks + Unchecks;
-			Rating = (float)Unchecks/Total;
+	return true;
+}
+
+bool MissingChecksPass::isReported(SrcUseRecord &R) {
 
 #ifndef UNIT_TEST
-			if (Rating > 0.1)
-				continue;
+	if (R.getRating() > (R.IsSrc ? ReportOpts.SrcThreshold
+				: ReportOpts.UseThreshold))
+		return false;
 #endif
 
-#ifdef REPORT_USE
+	if (R.IsSrc ? !ReportOpts.ReportSrc : !ReportOpts.ReportUse)
+		return false;
 
-#ifdef MC_ADDRTAKEN_FUNC_ONLY
-			// 
-			// Only consider address-taken functions?
-			// 
-
-			Instruction *UseI = dyn_cast<Instruction>(Use.first);
-			if (UseI) {
-				if (Ctx->AddressTakenFuncs.find(UseI->getParent()->getParent())
-						== Ctx->AddressTakenFuncs.end())
-					continue;
-			}
-#endif
+	// 
+	// Only consider address-taken functions?
+	// 
+	if (ReportOpts.AddrTakenOnly && !R.AddrTaken)
+		return false;
 
-			OP<<format("== [Use]: Rating: %.3f, Checks: %d, Unchecks: %d, Total: %d | Arg: %d\n", 
-					Rating, Checks, Unchecks, Total, (int)Use.second);
+	return true;
+}
 
-			for (Value *V : UseUnchecksMap[Use]) {
-				OP<<"\t"<<"\n";
-				printSourceCodeInfo(V);
-			}
-			OP<<"\n\n\n";
-#endif
-		}
+void MissingChecksPass::reportRecords(vector<SrcUseRecord> &Records,
+		ReportWriter &Writer) {
+
+	for (SrcUseRecord &R : Records) {
+		// Reported during stage 2 already
+		if (R.Streamed)
+			continue;
+		if (isReported(R))
+			Writer.add(move(R));
 	}
+	Writer.finish();
 }
 
-bool MissingChecksPass::doInitialization(Module *M) {
-  return false;
+void MissingChecksPass::processResults(const string &StatsFile) {
+
+	vector<SrcUseRecord> Records;
+	collectRecords(Records);
+
+	if (!StatsFile.empty()) {
+		vector<SourceInfo *> SIs;
+		for (SrcUseRecord &R : Records) {
+			for (SourceInfo &SI : R.KeyInfo)
+				SIs.push_back(&SI);
+			for (SourceInfo &SI : R.UncheckInfo)
+				SIs.push_back(&SI);
+		}
+		fetchSourceLines(SIs);
+		if (!writeRecords(StatsFile, Records))
+			OP << "Cannot write stats file " << StatsFile << "\n";
+	}
+
+	if (!StreamWriter)
+		StreamWriter = new ReportWriter(ReportOpts.Format,
+				ReportOpts.File);
+	if (!StreamWriter->isOpen())
+		ERR("Cannot write report file " << ReportOpts.File << "\n");
+	reportRecords(Records, *StreamWriter);
 }
 
-bool MissingChecksPass::doFinalization(Module *M) {
-  return false;
+bool MissingChecksPass::rerankResults(const string &StatsFile) {
+
+	vector<SrcUseRecord> Records;
+	double SrcThreshold = 1, UseThreshold = 1;
+	if (!readRecords(StatsFile, Records, SrcThreshold, UseThreshold))
+		return false;
+
+	// Sources and uses above the thresholds of the analysis were
+	// pruned before saved
+	if (ReportOpts.SrcThreshold > SrcThreshold
+			|| ReportOpts.UseThreshold > UseThreshold)
+		OP << format("Warning: statistics were saved with thresholds "
+				"%.3f / %.3f, so reports above them are incomplete\n",
+				SrcThreshold, UseThreshold);
+
+	ReportWriter Writer(ReportOpts.Format, ReportOpts.File);
+	if (!Writer.isOpen())
+		ERR("Cannot write report file " << ReportOpts.File << "\n");
+	reportRecords(Records, Writer);
+	return true;
 }
 
-bool MissingChecksPass::doModulePass(Module *M) {
+bool MissingChecksPass::writeCoreSummary(const string &SummaryFile) {
 
-	++MIdx;
+	ofstream summaryfile(SummaryFile);
+	if (!summaryfile.is_open())
+		return false;
 
-	for(Module::iterator f = M->begin(), fe = M->end();
-			f != fe; ++f) {
-		Function *F = &*f;
+	if (Partial || ChecksPartial)
+		OP << "Warning: the analysis stopped at the deadline, so "
+			<< "the core summary is partial\n";
 
-		if (F->empty())
+	// Exported functions, which drivers may call, with their
+	// call sites in the core kernel
+	for (Function *F : Ctx->UnifiedFuncSet) {
+		if (!F->hasExternalLinkage() || !F->hasName())
 			continue;
+		summaryfile << "F " << F->getName().str() << " "
+			<< countCallSites(F) << "\n";
+	}
+
+	// Sources and uses of indirect calls have no names to match in
+	// the driver, so only those of functions are saved
+	auto writeStats = [&](const char *Kind, SrcUseStatTable &Stats) {
+		for (SrcUseStat &SUS : Stats) {
+			Function *F = dyn_cast<Function>(SUS.Key.first);
+			if (!F || !F->hasExternalLinkage() || !F->hasName())
+				continue;
+			summaryfile << Kind << " " << F->getName().str() << " "
+				<< (int)SUS.Key.second << " " << SUS.CheckCount << " "
+				<< SUS.UncheckCount << " " << SUS.TotalCount << "\n";
+			for (const ModelSC &MSC : SUS.Checks)
+				summaryfile << "P " << MSC.SCO << " " << MSC.SCC << "\n";
+		}
+	};
+	writeStats("S", SrcStats);
+	writeStats("U", UseStats);
+	summaryfile.close();
+
+	return true;
+}
 
-		if (F->size() > MAX_BLOCKS_SUPPORT)
+bool MissingChecksPass::readCoreSummary(const string &SummaryFile,
+		GlobalContext *Ctx) {
+
+	ifstream summaryfile(SummaryFile);
+	if (!summaryfile.is_open())
+		return false;
+
+	string line, kind;
+	while (getline(summaryfile, line)) {
+		istringstream iss(line);
+		if (!(iss >> kind))
 			continue;
 
-		if (Ctx->UnifiedFuncSet.find(F) == Ctx->UnifiedFuncSet.end()) 
+		CoreStat CS{kind == "S", "", 0, 0, 0, 0, {}};
+		string Name;
+		unsigned NumSites;
+		int SCO, SCC;
+		if (kind == "F") {
+			if (iss >> Name >> NumSites) {
+				Ctx->CoreCallSites[Name] = NumSites;
+				continue;
+			}
+		}
+		else if (kind == "S" || kind == "U") {
+			if (iss >> CS.FuncName >> CS.ArgNo >> CS.CheckCount
+					>> CS.UncheckCount >> CS.TotalCount) {
+				CoreStats.push_back(move(CS));
+				continue;
+			}
+		}
+		else if (kind == "P" && CoreStats.size() && iss >> SCO >> SCC) {
+			CoreStats.back().Checks.push_back(make_pair(
+						(SCOperator)SCO, (SCCondition)SCC));
 			continue;
+		}
+		OP << "Ignoring malformed line in core summary: " << line << "\n";
+	}
 
-		// Stage 1: collect <source, check> and <<source, use>, check>
-		if (AnalysisStage == 1) {
+	OP << "## Core summary: " << Ctx->CoreCallSites.size()
+		<< " functions, " << CoreStats.size() << " sources and uses\n";
+	return true;
+}
 
-			// FunctionPass
+// Add the statistics of the core kernel to those of the functions it
+// exports, which the driver calls, before pruning them
+void MissingChecksPass::mergeCoreStats() {
+
+	unsigned NumMerged = 0;
+	for (CoreStat &CS : CoreStats) {
+		Function *F = Ctx->CoreFuncs.lookup(CS.FuncName);
+		if (!F)
+			continue;
+		src_t Key = make_pair(F, (int8_t)CS.ArgNo);
+		SrcUseStat &SUS = CS.IsSrc ? SrcStats.get(Key) : UseStats.get(Key);
+		SUS.CheckCount += CS.CheckCount;
+		SUS.UncheckCount += CS.UncheckCount;
+		SUS.TotalCount += CS.TotalCount;
+		for (auto &C : CS.Checks)
+			SUS.Checks.insert(ModelSC{C.first, C.second, F,
+					(int8_t)CS.ArgNo});
+		++NumMerged;
+	}
+	OP<<"## Merged "<<NumMerged<<" sources and uses of the core kernel\n";
+}
+
+MissingChecksPass::~MissingChecksPass() {
+	delete StreamWriter;
+}
+
+// Whether the function is analyzed by the pass
+bool MissingChecksPass::isAnalyzed(Function *F) {
+
+	if (F->empty())
+		return false;
+
+	if (F->size() > MAX_BLOCKS_SUPPORT)
+		return false;
+
+	if (Ctx->UnifiedFuncSet.find(F) == Ctx->UnifiedFuncSet.end()) 
+		return false;
+
+	return Ctx->isFocused(F) && Ctx->isReachable(F);
+}
+
+/// Check the deadline, and stop at it with partial results. Stage 1
+/// stops at the earlier deadline of checks, so that stage 2 still
+/// rates the sources and uses over the checks found.
+bool MissingChecksPass::reachedDeadline() {
+
+	if (!Ctx->hasDeadline())
+		return false;
+
+	if (AnalysisStage == 1) {
+		if (!ChecksPartial && Ctx->isPastChecksDeadline()) {
+			OP<<"## Deadline of checks reached, rating the checks found\n";
+			ChecksPartial = true;
+		}
+		return ChecksPartial;
+	}
+
+	if (!Partial && Ctx->isPastDeadline()) {
+		OP<<"## Deadline reached, reporting partial results\n";
+		Partial = true;
+	}
+	return Partial;
+}
+
+/// Leave a share of the time left to stage 2
+void MissingChecksPass::setChecksDeadline() {
+
+	if (!Ctx->hasDeadline())
+		return;
+	auto Now = chrono::steady_clock::now();
+	Ctx->ChecksDeadline = Now + chrono::duration_cast<
+		chrono::steady_clock::duration>(
+				(Ctx->Deadline - Now) * STAGE1_TIME_SHARE);
+}
+
+void MissingChecksPass::setChecksCounted() {
+
+	ChecksCounted = true;
+	// Checks are identified from now on
+	setChecksDeadline();
+}
+
+/// Stage 1 on the function: count the checks of its sources and uses
+void MissingChecksPass::countChecks(Function *F) {
+
+	if (reachedDeadline())
+		return;
 
 #ifdef MC_DEBUG
 #ifdef UNIT_TEST
-			size_t sz = sizeof(test_funcs)/sizeof(test_funcs[0]);
-			auto fstr = find(test_funcs, test_funcs + sz, F->getName().str());
-			if (fstr == test_funcs + sz)
-				continue;
+	size_t sz = sizeof(test_funcs)/sizeof(test_funcs[0]);
+	auto fstr = find(test_funcs, test_funcs + sz, F->getName().str());
+	if (fstr == test_funcs + sz)
+		return;
 
-			OP<<"[S"<<AnalysisStage<<"] on function: "
-				<< "\033[32m" << F->getName() << "\033[0m" << '\n';
+	OP<<"[S"<<AnalysisStage<<"] on function: "
+		<< "\033[32m" << F->getName() << "\033[0m" << '\n';
 #endif
 
-			OP<<"[S"<<AnalysisStage<<"] on function: "
-				<< "\033[32m" << F->getName() << "\033[0m" << '\n';
+	OP<<"[S"<<AnalysisStage<<"] on function: "
+		<< "\033[32m" << F->getName() << "\033[0m" << '\n';
 #endif
 
-			set<Value *>SCSet = Ctx->CheckInstSets[F];
-			if (SCSet.empty())
-				continue;
+	set<Value *>SCSet = Ctx->CheckInstSets[F];
+	if (SCSet.empty())
+		return;
 
-			for (auto SC : SCSet) {
+	for (auto SC : SCSet) {
 #ifdef MC_DEBUG
-				OP << "\n== Security check: " << *SC << "\n";
-				printSourceCodeInfo(SC);
+		OP << "\n== Security check: " << *SC << "\n";
+		printSourceCodeInfo(SC);
 #endif 
 
-				CmpInst *SCI = dyn_cast<CmpInst>(SC);
-				if (!SCI)
-					continue;
+		CmpInst *SCI = dyn_cast<CmpInst>(SC);
+		if (!SCI)
+			continue;
 
-				// Count the check for checked sources and related uses
-				countSrcUseChecks(F, SCI);
-			}
+		// Count the check for checked sources and related uses
+		countSrcUseChecks(F, SCI);
+	}
+}
+
+bool MissingChecksPass::doInitialization(Module *M) {
+  return false;
+}
+
+bool MissingChecksPass::doFinalization(Module *M) {
+  return false;
+}
+
+void MissingChecksPass::beginStage(unsigned Stage) {
+
+	if (AnalysisStage == 1 && !ChecksCounted)
+		setChecksDeadline();
+
+	// With a deadline, stage 2 visits all functions in the order of
+	// priorities at once, see prioritizeUncheckSites()
+	if (AnalysisStage == 2 && Ctx->hasDeadline()) {
+		for (Function *F : Worklist) {
+			if (reachedDeadline())
+				break;
+
+			countSrcUseUnchecks(F);
+			if (StreamWriter)
+				streamFinalized(F);
+		}
+	}
+}
+
+bool MissingChecksPass::endStage(unsigned Stage) {
+
+	// Verify the sampled results of stage 2 with all call sites
+	if (AnalysisStage == 2 && UnsampledSites.size() && !Verifying) {
+		pruneSampled();
+		collectUncheckSites(false);
+		if (Ctx->hasDeadline())
+			prioritizeUncheckSites();
+		Verifying = true;
+		if (StreamWriter)
+			collectPendingCallees();
+		OP<<"## Verify stage "<<AnalysisStage<<"\n";
+		return true;
+	}
+
+	// Identifying the checks may have stopped at their deadline
+	if (AnalysisStage == 1)
+		reachedDeadline();
+
+	++AnalysisStage;
+	if (AnalysisStage == 2) {
+		if (!CoreStats.empty())
+			mergeCoreStats();
+		if (!KeepAll)
+			pruneUnsupported();
+		collectUncheckSites(true);
+		if (Ctx->hasDeadline())
+			prioritizeUncheckSites();
+
+		// Report the sources and uses as soon as their
+		// statistics are final
+		if (ReportOpts.Stream) {
+			StreamWriter = new ReportWriter(ReportOpts.Format,
+					ReportOpts.File);
+			if (!StreamWriter->isOpen())
+				ERR("Cannot write report file " << ReportOpts.File << "\n");
+			collectPendingCallees();
+		}
+	}
+	if (AnalysisStage <= MAX_STAGE) {
+		OP<<"## Move to stage "<<AnalysisStage<<"\n";
+		return true;
+	}
+
+	return false;
+}
+
+bool MissingChecksPass::doModulePass(Module *M) {
+
+	// Counted while identifying the checks, see countChecks()
+	if (AnalysisStage == 1 && ChecksCounted)
+		return false;
+
+	// With a deadline, stage 2 is done in the order of priorities
+	// already, see beginStage()
+	if (AnalysisStage == 2 && Ctx->hasDeadline())
+		return false;
+
+	for(Module::iterator f = M->begin(), fe = M->end();
+			f != fe; ++f) {
+		Function *F = &*f;
+
+		if (reachedDeadline())
+			break;
+
+		if (!isAnalyzed(F))
+			continue;
+
+		// Stage 1: collect <source, check> and <<source, use>, check>
+		if (AnalysisStage == 1) {
+			countChecks(F);
 		}
 
 		// Stage 2: check if the sources and <source, use> pairs have
@@ -1303,6 +1937,8 @@ bool MissingChecksPass::doModulePass(Module *M) {
 
 			// Count unchecks for the function
 			countSrcUseUnchecks(F);
+			if (StreamWriter)
+				streamFinalized(F);
 
 		}
 		// Stage 3: generate bug reports
@@ -1313,14 +1949,5 @@ bool MissingChecksPass::doModulePass(Module *M) {
 		}
 	}
 
-	if (Ctx->Modules.size() == MIdx) {
-		++AnalysisStage;
-		MIdx = 0;
-		if (AnalysisStage <= MAX_STAGE) {
-			OP<<"## Move to stage "<<AnalysisStage<<"\n";
-			return true;
-		}
-	}
-
 	return false;
 }
@@ -42,47 +42,242 @@ struct ModelSC {
 	}
 };
 
+// Statistics of a checked source or use
+struct SrcUseStat {
+	src_t Key;
+	unsigned CheckCount;
+	unsigned UncheckCount;
+	unsigned TotalCount;
+	// Checks and unchecks of the source or use
+	set<ModelSC> Checks;
+	set<Value *> Unchecks;
+	// Reported during the analysis already
+	bool Streamed;
+};
+
+// Statistics of checked sources or uses. A <function or call site,
+// argument number> key is hashed once into a dense ID, and the
+// statistics are kept in a flat array indexed by the ID.
+class SrcUseStatTable {
+
+	public:
+		void reserve(unsigned NumKeys) {
+			IDs.reserve(NumKeys);
+			Stats.reserve(NumKeys);
+		}
+
+		// Get the statistics of the key, adding it if absent
+		SrcUseStat &get(src_t Key) {
+			auto It = IDs.insert(make_pair(make_pair(Key.first,
+							(int)Key.second), Stats.size()));
+			if (It.second)
+				Stats.push_back(SrcUseStat{Key, 0, 0, 0, {}, {}, false});
+			return Stats[It.first->second];
+		}
+
+		// Get the statistics of the key, or NULL if it is not checked
+		SrcUseStat *find(src_t Key) {
+			auto It = IDs.find(make_pair(Key.first, (int)Key.second));
+			return It == IDs.end() ? NULL : &Stats[It->second];
+		}
+
+		// Remove the statistics satisfying the predicate
+		template <typename Pred>
+		void removeIf(Pred P) {
+			vector<SrcUseStat> Kept;
+			IDs.clear();
+			for (SrcUseStat &SUS : Stats) {
+				if (P(SUS))
+					continue;
+				IDs[make_pair(SUS.Key.first, (int)SUS.Key.second)] = Kept.size();
+				Kept.push_back(move(SUS));
+			}
+			Stats.swap(Kept);
+		}
+
+		size_t size() { return Stats.size(); }
+		vector<SrcUseStat>::iterator begin() { return Stats.begin(); }
+		vector<SrcUseStat>::iterator end() { return Stats.end(); }
+
+	private:
+		DenseMap<pair<Value *, int>, unsigned> IDs;
+		vector<SrcUseStat> Stats;
+};
+
+// A reported candidate of source or use, as saved in the stats file.
+// It does not refer to any IR, so that reports can be re-ranked
+// without loading bitcode files.
+struct SrcUseRecord {
+	bool IsSrc;
+	// "retval", "argmt", or "param" for sources
+	string SrcTy;
+	int ArgNo;
+	unsigned CheckCount;
+	unsigned UncheckCount;
+	unsigned TotalCount;
+	// Whether the function of the source or use is address-taken
+	bool AddrTaken;
+	// Location of an argument source, if any
+	vector<SourceInfo> KeyInfo;
+	// Locations of the unchecks
+	vector<SourceInfo> UncheckInfo;
+	// Models of the peer checks
+	vector<pair<SCOperator, SCCondition>> PeerChecks;
+	// Reported during the analysis already
+	bool Streamed = false;
+	// Not all call sites were visited before the deadline
+	bool Partial = false;
+
+	// Ratio of unchecks to the checked and unchecked call sites
+	float getRating() const {
+		unsigned Total = min(TotalCount, CheckCount + UncheckCount);
+		return Total ? (float)UncheckCount/Total : 0;
+	}
+};
+
+// Statistics of a source or use of a function exported by the core
+// kernel, as saved in a core summary. Drivers are analyzed against
+// them instead of loading the core kernel.
+struct CoreStat {
+	bool IsSrc;
+	string FuncName;
+	int ArgNo;
+	unsigned CheckCount;
+	unsigned UncheckCount;
+	unsigned TotalCount;
+	vector<pair<SCOperator, SCCondition>> Checks;
+};
+
+enum MCReportFormat {
+	RF_TEXT,
+	RF_JSONL,
+	RF_SARIF,
+};
+
+// Options of reporting missing checks. They can be set at runtime
+// and changed when re-ranking saved statistics.
+struct MCReportOptions {
+	// Sources and uses with higher uncheck ratings are not reported
+	double SrcThreshold;
+	double UseThreshold;
+	// Only report sources and uses in address-taken functions
+	bool AddrTakenOnly;
+	bool ReportSrc;
+	bool ReportUse;
+	MCReportFormat Format;
+	// Write the report into the file, or to stderr if it is empty
+	string File;
+	// Report sources and uses during stage 2, as soon as all their
+	// call sites are visited
+	bool Stream;
+};
+
+class ReportWriter;
+
 class MissingChecksPass : public IterativeModulePass {
 
 	public:
 
 		static int AnalysisStage;
-		static map<src_t, unsigned>SrcCheckCount;
-		static map<use_t, unsigned>UseCheckCount;
-		static map<src_t, unsigned>SrcUncheckCount;
-		static map<use_t, unsigned>UseUncheckCount;
-		static map<use_t, unsigned>SrcTotalCount;
-		static map<use_t, unsigned>UseTotalCount;
-		// Sources with security checks
-		static set<src_t>CheckedSrcSet;
-		static set<use_t>CheckedUseSet;
-		// Maps of checks to src/use 
-		static map<src_t, set<ModelSC>>SrcChecksMap;
-		static map<use_t, set<ModelSC>>UseChecksMap;
-		// Maps of unchecks to src/use
-		static map<src_t, set<Value *>>SrcUnchecksMap;
-		static map<use_t, set<Value *>>UseUnchecksMap;
+		// Statistics of sources and uses with security checks
+		static SrcUseStatTable SrcStats;
+		static SrcUseStatTable UseStats;
 		// Analyzed sources
 		static set<Value *>TrackedSrcSet;
 		static set<Value *>TrackedUseSet;
+		static MCReportOptions ReportOpts;
+		// Statistics of the core kernel read from a core summary
+		static vector<CoreStat> CoreStats;
 
 		MissingChecksPass(GlobalContext *Ctx_)
 			: IterativeModulePass(Ctx_, "MissingChecks"), 
 			DFA(Ctx_) {
-				MIdx = 0;
+				Verifying = false;
+				Partial = false;
+				ChecksPartial = false;
+				ChecksCounted = false;
+				KeepAll = false;
+				SampledStage2 = false;
+				StreamWriter = NULL;
+				// Keys are callees and indirect call sites
+				SrcStats.reserve(Ctx->Callers.size()
+						+ Ctx->IndirectCallInsts.size());
+				UseStats.reserve(Ctx->Callers.size());
 			}
+		~MissingChecksPass();
 		virtual bool doInitialization(llvm::Module *);
 		virtual bool doFinalization(llvm::Module *);
 		virtual bool doModulePass(llvm::Module *);
+		virtual void beginStage(unsigned Stage);
+		virtual bool endStage(unsigned Stage);
 
-		// Process final results
-		void processResults();
+		// Process final results, saving the statistics into StatsFile
+		// if it is given
+		void processResults(const string &StatsFile = "");
+
+		// Report the results saved in StatsFile with the current
+		// report options
+		static bool rerankResults(const string &StatsFile);
+
+		// Save the exported functions with their call sites, and the
+		// statistics of their sources and uses, as a core summary
+		bool writeCoreSummary(const string &SummaryFile);
+		// Read a core summary before building the call graph of a
+		// driver analyzed against it
+		static bool readCoreSummary(const string &SummaryFile,
+				GlobalContext *Ctx);
+
+		// Stage 1 on the function, as soon as its checks are
+		// identified; the stage-1 sweep is then skipped
+		void countChecks(Function *F);
+		void setChecksCounted();
+		// Keep all sources and uses with their exact counts, e.g.,
+		// for a core summary: drivers may add support to those
+		// without enough, and change the ratings of the others
+		void setKeepAll() { KeepAll = true; }
+		// Slice a sample of the call sites of each callee first,
+		// which is faster but drops sources and uses by confidence
+		// bounds, so reports may differ from an exhaustive stage 2
+		void setSampledStage2() { SampledStage2 = true; }
 
 	private:
 
 		DataFlowAnalysis DFA;   //找到所有的源，但这里源的常量+errcode好像没对应，param也没有，SrcSet；UseSet差不多和论文内容写的相符。由SourceSet，找到CVset，跟踪 
-		int MIdx;
+		// Stopped at the deadline of the analysis
+		bool Partial;
+		// Stage 1 stopped at the deadline of checks, so the checks
+		// of all sources and uses are partial
+		bool ChecksPartial;
+		// Stage 1 done while identifying the checks
+		bool ChecksCounted;
+		bool KeepAll;
+		bool SampledStage2;
+
+		bool reachedDeadline();
+		void setChecksDeadline();
+		// Functions of stage 2 in the order of priorities, if there
+		// is a deadline
+		vector<Function *> Worklist;
 		set<Instruction *>CheckSet;
+		// Call sites of checked sources and uses, per caller
+		DenseMap<Function *, vector<CallInst *>> UncheckSites;
+		// Call sites left out of the sample of each callee
+		DenseMap<Value *, vector<CallInst *>> UnsampledSites;
+		// In the verification round of stage 2
+		bool Verifying;
+
+		// Statistics of a callee to be reported when its call sites
+		// in the round are all visited
+		struct PendingCallee {
+			vector<SrcUseStat *> Stats;
+			unsigned NumSites = 0;
+		};
+		DenseMap<Value *, PendingCallee> PendingCallees;
+		// Writer of the report, created early if streaming
+		ReportWriter *StreamWriter;
+
+		bool isAnalyzed(Function *F);
+		bool isSkippedCallee(Function *CF);
                 // 别名
 		void collectAliasPointers(Function *, LoadInst*, set <Value *> &);
 
@@ -108,8 +303,30 @@ class MissingChecksPass : public IterativeModulePass {
 				bool &isChecked, unsigned &Depth);
 
 		void countSrcUseChecks(Function *F, Instruction *SCI);  // 确定每次安全检查中使用的关键变量/函数。
+		unsigned countCallSites(Value *V);
+		bool isSupported(SrcUseStat &SUS, double Threshold);
+		void pruneUnsupported();
+		void mergeCoreStats();
+		void collectUncheckSites(bool Sampling);
+		void pruneSampled();
 		void countSrcUseUnchecks(Function *F);
 
+		SrcUseRecord makeRecord(SrcUseStat &SUS, bool IsSrc);
+		void collectRecords(vector<SrcUseRecord> &Records);
+		void prioritizeUncheckSites();
+		void collectPendingCallees();
+		Value *getSiteCallee(CallInst *CI);
+		void streamStats(PendingCallee &PC);
+		void streamFinalized(Function *F);
+		static bool isReported(SrcUseRecord &R);
+		static bool writeRecords(const string &StatsFile,
+				vector<SrcUseRecord> &Records);
+		static bool readRecords(const string &StatsFile,
+				vector<SrcUseRecord> &Records, double &SrcThreshold,
+				double &UseThreshold);
+		static void reportRecords(vector<SrcUseRecord> &Records,
+				ReportWriter &Writer);
+
 		ModelSC modelCheck(CmpInst *CmpI, Value *SrcUse, int8_t ArgNo);
 		void addSrcCheck(src_t Src, ModelSC MSC);
 		void addUseCheck(use_t Use, ModelSC MSC);
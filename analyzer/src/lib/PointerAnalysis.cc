@@ -7,6 +7,8 @@
 
 /// Alias types used to do pointer analysis.
 #define MUST_ALIAS
+/// Modules whose alias analyses are kept set up
+#define MAX_AA_MODULES 16
 
 bool PointerAnalysisPass::doInitialization(Module *M) {
 	return false;
@@ -120,29 +122,10 @@ void PointerAnalysisPass::detectAliasPointers(Function *F,
 	std::set<Value *> addr2Set;
 	Value *Addr1, *Addr2;
 
-	// Collect interesting pointers
-	for (inst_iterator i = inst_begin(F), ei = inst_end(F);
-			i != ei; ++i) {
-
-		Instruction *I = dyn_cast<Instruction>(&*i);
-
-		if (LoadInst *LI = dyn_cast<LoadInst>(I)) {
-			addr1Set.insert(LI->getPointerOperand());
-		}
-		else if (StoreInst *SI = dyn_cast<StoreInst>(I)) {
-			addr1Set.insert(SI->getPointerOperand());
-		}
-		else if ( CallInst *CI = dyn_cast<CallInst>(I)) {
-			for (unsigned j = 0, ej = CI->getNumArgOperands();
-					j < ej; ++j) {
-				Value *Arg = CI->getArgOperand(j);
-
-				if (!Arg->getType()->isPointerTy())
-					continue;
-				addr1Set.insert(Arg);
-			}
-		}
-	}
+	// Collect interesting pointers, i.e., those loaded from, stored
+	// to, or passed to calls
+	const FuncFacts &FF = Ctx->getFuncFacts(F);
+	addr1Set.insert(FF.Pointers.begin(), FF.Pointers.end());
 
 	// FIXME: avoid being stuck
 	if (addr1Set.size() > 1000) {
@@ -188,45 +171,96 @@ void PointerAnalysisPass::detectAliasPointers(Function *F,
 	}
 }
 
-bool PointerAnalysisPass::doModulePass(Module *M) {
+PointerAnalysisPass::~PointerAnalysisPass() {
+	releaseModules();
+}
 
-	// Save TargetLibraryInfo.
-	Triple ModuleTriple(M->getTargetTriple());
-	TargetLibraryInfoImpl TLII(ModuleTriple);
-	TLI = new TargetLibraryInfo(TLII);
+void PointerAnalysisPass::releaseModules() {
 
-	// Run BasicAliasAnalysis pass on each function in this module.
-	// XXX: more complicated alias analyses may be required.
-	legacy::FunctionPassManager *FPasses = new legacy::FunctionPassManager(M);
-	AAResultsWrapperPass *AARPass = new AAResultsWrapperPass();
+	for (ModuleAA &MAA : ModuleAAs)
+		MAA.FPasses->doFinalization();
+	ModuleAAs.clear();
+	ModuleAAIndex.clear();
+}
 
-	FPasses->add(AARPass);
+PointerAnalysisPass::ModuleAA &PointerAnalysisPass::getModuleAA(Module *M) {
 
-	FPasses->doInitialization();
-	for (Function &F : *M) {
-		if (F.isDeclaration())
-			continue;
-		FPasses->run(F);
+	auto It = ModuleAAIndex.find(M);
+	if (It != ModuleAAIndex.end()) {
+		ModuleAAs.splice(ModuleAAs.begin(), ModuleAAs, It->second);
+		return ModuleAAs.front();
+	}
+
+	if (ModuleAAs.size() >= MAX_AA_MODULES) {
+		ModuleAAs.back().FPasses->doFinalization();
+		ModuleAAIndex.erase(ModuleAAs.back().M);
+		ModuleAAs.pop_back();
 	}
-	FPasses->doFinalization();
 
-	// Basic alias analysis result.
-	AAResults &AAR = AARPass->getAAResults();
+	ModuleAA MAA{M, unique_ptr<legacy::FunctionPassManager>(
+			new legacy::FunctionPassManager(M)), new AAResultsWrapperPass()};
+	MAA.FPasses->add(MAA.AARPass);
+	MAA.FPasses->doInitialization();
+	ModuleAAs.push_front(move(MAA));
+	ModuleAAIndex[M] = ModuleAAs.begin();
+	return ModuleAAs.front();
+}
+
+void PointerAnalysisPass::analyzeFunction(Function *F,
+		PointerAnalysisMap &aliasPtrs) {
+
+	// Run BasicAliasAnalysis pass on each function in this module.
+	// XXX: more complicated alias analyses may be required.
+	ModuleAA &MAA = getModuleAA(F->getParent());
+
+	// Basic alias analysis result of the function
+	MAA.FPasses->run(*F);
+	detectAliasPointers(F, MAA.AARPass->getAAResults(), aliasPtrs);
+}
+
+bool PointerAnalysisPass::doModulePass(Module *M) {
 
 	for (Module::iterator f = M->begin(), fe = M->end();
 			f != fe; ++f) {
 		Function *F = &*f;
 		PointerAnalysisMap aliasPtrs;
 
-		if (F->empty())
+		if (F->empty() || !Ctx->isFocused(F) || !Ctx->isReachable(F))
 			continue;
 
-		detectAliasPointers(F, AAR, aliasPtrs);
+		analyzeFunction(F, aliasPtrs);
 
 		// Save pointer analysis result.
 		Ctx->FuncPAResults[F] = aliasPtrs;
-		Ctx->FuncAAResults[F] = &AAR;
 	}
+	releaseModules();
 
 	return false;
 }
+
+PointerAnalysisMap &PointerAnalysisCache::get(Function *F) {
+
+	auto It = Index.find(F);
+	if (It != Index.end()) {
+		Entries.splice(Entries.begin(), Entries, It->second);
+		return It->second->second;
+	}
+
+	if (Capacity && Entries.size() >= Capacity) {
+		Index.erase(Entries.back().first);
+		Entries.pop_back();
+	}
+	Entries.emplace_front(F, PointerAnalysisMap());
+	Index[F] = Entries.begin();
+	// Consistent with PointerAnalysisPass::doModulePass()
+	if (!F->empty() && Ctx->isFocused(F) && Ctx->isReachable(F))
+		PAPass->analyzeFunction(F, Entries.front().second);
+	return Entries.front().second;
+}
+
+PointerAnalysisMap &GlobalContext::getPAResults(Function *F) {
+
+	if (PACache)
+		return PACache->get(F);
+	return FuncPAResults[F];
+}
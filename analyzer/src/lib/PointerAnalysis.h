@@ -3,11 +3,26 @@
 
 #include "Analyzer.h"
 
+#include <llvm/IR/LegacyPassManager.h>
+
+#include <list>
+
 class PointerAnalysisPass : public IterativeModulePass {
 	typedef std::pair<Value *, MemoryLocation *> AddrMemPair;
 
 	private:
-	TargetLibraryInfo *TLI;
+	// Alias analysis of the functions of a module
+	struct ModuleAA {
+		Module *M;
+		unique_ptr<legacy::FunctionPassManager> FPasses;
+		AAResultsWrapperPass *AARPass;
+	};
+	// Of the most recently used modules first, so that results
+	// computed on demand across modules do not set them up again
+	std::list<ModuleAA> ModuleAAs;
+	DenseMap<Module *, decltype(ModuleAAs)::iterator> ModuleAAIndex;
+
+	ModuleAA &getModuleAA(Module *M);
 
 	void collectPointers(Function *, set<Value *> &PSet);
 
@@ -20,9 +35,41 @@ class PointerAnalysisPass : public IterativeModulePass {
 	public:
 	PointerAnalysisPass(GlobalContext *Ctx_)
 		: IterativeModulePass(Ctx_, "PointerAnalysis") { }
+	~PointerAnalysisPass();
 	virtual bool doInitialization(llvm::Module *);
 	virtual bool doFinalization(llvm::Module *);
 	virtual bool doModulePass(llvm::Module *);
+
+	// Detect the aliased pointers in the function
+	void analyzeFunction(Function *F, PointerAnalysisMap &aliasPtrs);
+	// Release the alias analyses of the modules
+	void releaseModules();
+};
+
+//
+// Pointer analysis results computed on demand, instead of for all
+// functions ahead. At most Capacity functions are kept, and the
+// least recently used ones are evicted first, so that the memory does
+// not grow with the number of analyzed functions.
+//
+class PointerAnalysisCache {
+
+	public:
+		PointerAnalysisCache(GlobalContext *Ctx_,
+				PointerAnalysisPass *PAPass_, unsigned Capacity_)
+			: Ctx(Ctx_), PAPass(PAPass_), Capacity(Capacity_) {}
+
+		// The results are valid until the next call, which may
+		// evict them
+		PointerAnalysisMap &get(Function *F);
+
+	private:
+		GlobalContext *Ctx;
+		PointerAnalysisPass *PAPass;
+		unsigned Capacity;
+		// Most recently used first
+		std::list<pair<Function *, PointerAnalysisMap>> Entries;
+		DenseMap<Function *, decltype(Entries)::iterator> Index;
 };
 
 #endif
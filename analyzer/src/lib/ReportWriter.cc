@@ -0,0 +1,242 @@
+//===-- ReportWriter.cc - Write missing-check reports-------------===//
+//
+// This file implements the writer of missing-check reports, which
+// formats findings on a background thread, so that fetching code
+// lines and formatting do not block the analysis.
+//
+//===-----------------------------------------------------------===//
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+
+#include "ReportWriter.h"
+
+ReportWriter::ReportWriter(MCReportFormat Format_, const string &File)
+	: Format(Format_), OS(NULL), NumWritten(0), Finished(false) {
+
+	if (File.empty())
+		OS = &errs();
+	else {
+		error_code EC;
+		FileOS.reset(new raw_fd_ostream(File, EC, sys::fs::OF_Text));
+		if (EC) {
+			FileOS.reset();
+			return;
+		}
+		OS = FileOS.get();
+	}
+
+	if (Format == RF_SARIF)
+		*OS << "{\"version\":\"2.1.0\","
+			<< "\"$schema\":\"https://json.schemastore.org/sarif-2.1.0.json\","
+			<< "\"runs\":[{\"tool\":{\"driver\":{\"name\":\"Crix\","
+			<< "\"rules\":[{\"id\":\"missing-check-src\"},"
+			<< "{\"id\":\"missing-check-use\"}]}},\"results\":[\n";
+
+	Worker = thread(&ReportWriter::run, this);
+}
+
+ReportWriter::~ReportWriter() {
+	finish();
+}
+
+void ReportWriter::add(SrcUseRecord &&R) {
+	{
+		lock_guard<mutex> Guard(QueueLock);
+		Queue.push_back(move(R));
+	}
+	QueueReady.notify_one();
+}
+
+void ReportWriter::finish() {
+
+	if (!Worker.joinable())
+		return;
+
+	{
+		lock_guard<mutex> Guard(QueueLock);
+		Finished = true;
+	}
+	QueueReady.notify_one();
+	Worker.join();
+
+	if (Format == RF_SARIF)
+		*OS << "\n]}]}\n";
+	OS->flush();
+}
+
+void ReportWriter::run() {
+
+	vector<SrcUseRecord> Batch;
+	while (true) {
+		{
+			unique_lock<mutex> Guard(QueueLock);
+			QueueReady.wait(Guard, [this] {
+					return Finished || !Queue.empty(); });
+			if (Queue.empty())
+				break;
+			Batch.swap(Queue);
+		}
+		writeBatch(Batch);
+		Batch.clear();
+	}
+}
+
+void ReportWriter::writeBatch(vector<SrcUseRecord> &Batch) {
+
+	// Read each source file once for the batch
+	vector<SourceInfo *> SIs;
+	for (SrcUseRecord &R : Batch) {
+		for (SourceInfo &SI : R.KeyInfo)
+			SIs.push_back(&SI);
+		for (SourceInfo &SI : R.UncheckInfo)
+			SIs.push_back(&SI);
+	}
+	fetchSourceLines(SIs);
+
+	// Format the batch before writing, as stderr is unbuffered
+	string Buffer;
+	raw_string_ostream ROS(Buffer);
+	for (SrcUseRecord &R : Batch) {
+		switch (Format) {
+			case RF_TEXT:
+				writeText(R, ROS);
+				break;
+			case RF_JSONL:
+				writeJSON(R, ROS);
+				break;
+			case RF_SARIF:
+				writeSARIF(R, ROS);
+				break;
+		}
+		++NumWritten;
+	}
+	*OS << ROS.str();
+	OS->flush();
+}
+
+void ReportWriter::writeText(SrcUseRecord &R, raw_ostream &ROS) {
+
+	if (R.IsSrc) {
+		ROS<<format("== [Src-%s]: Rating: %.3f, Checks: %d, Unchecks: %d, Total: %d | Arg: %d\n",
+				R.SrcTy.c_str(), R.getRating(), R.CheckCount, R.UncheckCount,
+				min(R.TotalCount, R.CheckCount + R.UncheckCount), R.ArgNo);
+
+		if (R.SrcTy == "argmt") {
+			for (SourceInfo &SI : R.KeyInfo)
+				printSourceInfo(SI, ROS);
+
+			ROS<<"\n\tUnchecks:";
+		}
+	}
+	else
+		ROS<<format("== [Use]: Rating: %.3f, Checks: %d, Unchecks: %d, Total: %d | Arg: %d\n",
+				R.getRating(), R.CheckCount, R.UncheckCount,
+				min(R.TotalCount, R.CheckCount + R.UncheckCount), R.ArgNo);
+
+	for (SourceInfo &SI : R.UncheckInfo) {
+		ROS<<"\t"<<"\n";
+		printSourceInfo(SI, ROS);
+	}
+
+	// Print peer functions
+	if (R.SrcTy == "argmt")
+		ROS<<"\n\tPeer checks:\n";
+
+	if (R.Partial)
+		ROS<<"\t[Partial]: not all call sites were analyzed before the deadline\n";
+
+	ROS<<"\n\n\n";
+}
+
+static json::Object locationJSON(SourceInfo &SI) {
+	return json::Object{
+		{"file", SI.File},
+		{"line", SI.LineNo},
+		{"code", SI.Line},
+	};
+}
+
+void ReportWriter::writeJSON(SrcUseRecord &R, raw_ostream &ROS) {
+
+	json::Array Unchecks, PeerChecks;
+	for (SourceInfo &SI : R.UncheckInfo)
+		Unchecks.push_back(locationJSON(SI));
+	for (auto &PC : R.PeerChecks)
+		PeerChecks.push_back(json::Object{
+				{"operator", (int)PC.first},
+				{"condition", (int)PC.second},
+				});
+
+	json::Object Finding{
+		{"kind", R.IsSrc ? "src" : "use"},
+		{"rating", (double)R.getRating()},
+		{"checks", R.CheckCount},
+		{"unchecks", R.UncheckCount},
+		{"total", min(R.TotalCount, R.CheckCount + R.UncheckCount)},
+		{"arg", R.ArgNo},
+		{"addr_taken", R.AddrTaken},
+		{"uncheck_locations", move(Unchecks)},
+		{"peer_checks", move(PeerChecks)},
+		{"partial", R.Partial},
+	};
+	if (R.IsSrc)
+		Finding["src_type"] = R.SrcTy;
+	if (!R.KeyInfo.empty())
+		Finding["location"] = locationJSON(R.KeyInfo.front());
+
+	ROS << json::Value(move(Finding)) << "\n";
+}
+
+static json::Object locationSARIF(SourceInfo &SI) {
+	return json::Object{
+		{"physicalLocation", json::Object{
+			{"artifactLocation", json::Object{{"uri", SI.File}}},
+			{"region", json::Object{
+				{"startLine", SI.LineNo},
+				{"snippet", json::Object{{"text", SI.Line}}},
+			}},
+		}},
+	};
+}
+
+void ReportWriter::writeSARIF(SrcUseRecord &R, raw_ostream &ROS) {
+
+	// Unchecks are the locations of possible bugs, and the checked
+	// source is related
+	json::Array Locations, RelatedLocations;
+	for (SourceInfo &SI : R.UncheckInfo)
+		Locations.push_back(locationSARIF(SI));
+	for (SourceInfo &SI : R.KeyInfo)
+		RelatedLocations.push_back(locationSARIF(SI));
+
+	string Message;
+	raw_string_ostream MOS(Message);
+	if (R.IsSrc)
+		MOS << "Missing check of a source (" << R.SrcTy << ")";
+	else
+		MOS << "Missing check of a use";
+	MOS << format(", checked at %d of %d call sites, rating %.3f",
+			R.CheckCount, min(R.TotalCount, R.CheckCount + R.UncheckCount),
+			R.getRating());
+
+	json::Object Result{
+		{"ruleId", R.IsSrc ? "missing-check-src" : "missing-check-use"},
+		{"level", "warning"},
+		{"message", json::Object{{"text", MOS.str()}}},
+		{"locations", move(Locations)},
+		{"relatedLocations", move(RelatedLocations)},
+		{"properties", json::Object{
+			{"rating", (double)R.getRating()},
+			{"checks", R.CheckCount},
+			{"unchecks", R.UncheckCount},
+			{"arg", R.ArgNo},
+			{"partial", R.Partial},
+		}},
+	};
+
+	if (NumWritten)
+		ROS << ",\n";
+	ROS << json::Value(move(Result));
+}
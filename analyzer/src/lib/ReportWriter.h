@@ -0,0 +1,55 @@
+#ifndef REPORT_WRITER_H
+#define REPORT_WRITER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "MissingChecks.h"
+
+//
+// Writer of missing-check reports. Findings are queued by the
+// analysis and written by a background thread, which fetches the
+// code lines of a batch of findings grouped by source file and
+// formats them into a buffered stream.
+//
+// Formats:
+//   RF_TEXT  - the colored text for manual analyses
+//   RF_JSONL - one JSON object per finding
+//   RF_SARIF - a SARIF 2.1.0 log, with one result per finding
+//
+class ReportWriter {
+
+	public:
+		// Write into the file, or to stderr if it is empty
+		ReportWriter(MCReportFormat Format, const string &File);
+		~ReportWriter();
+
+		bool isOpen() { return OS != NULL; }
+
+		// Queue a finding to be written
+		void add(SrcUseRecord &&R);
+
+		// Write the queued findings, and wait for the writer
+		void finish();
+
+	private:
+		void run();
+		void writeBatch(vector<SrcUseRecord> &Batch);
+		void writeText(SrcUseRecord &R, raw_ostream &ROS);
+		void writeJSON(SrcUseRecord &R, raw_ostream &ROS);
+		void writeSARIF(SrcUseRecord &R, raw_ostream &ROS);
+
+		MCReportFormat Format;
+		unique_ptr<raw_fd_ostream> FileOS;
+		raw_ostream *OS;
+		unsigned NumWritten;
+
+		mutex QueueLock;
+		condition_variable QueueReady;
+		vector<SrcUseRecord> Queue;
+		bool Finished;
+		thread Worker;
+};
+
+#endif
@@ -42,6 +42,17 @@ using namespace std;
 
 // SelectInsts that take error codes
 set<Instruction *>SecurityChecksPass::ErrSelectInstSet;
+mutex SecurityChecksPass::ErrSelectLock;
+
+/// Get the first potential callee of the call, without adding an
+/// entry to Callees, so that functions can be analyzed in parallel
+Function *SecurityChecksPass::getFirstCallee(CallInst *CI) {
+
+	auto It = Ctx->Callees.find(CI);
+	if (It == Ctx->Callees.end() || It->second.empty())
+		return NULL;
+	return *It->second.begin();
+}
 
 /// Check if the value is an errno.
 bool SecurityChecksPass::isValueErrno(Value *V, Function *F) {
@@ -133,8 +144,8 @@ void SecurityChecksPass::findErrorCodes(Function *F) {
 			continue;
 
 		StringRef FName = getCalledFuncName(CI);
-		auto FIter = Ctx->ErrorHandleFuncs.find(FName.str());
-		if (FIter == Ctx->ErrorHandleFuncs.end()) 
+		const FuncRoleInfo *FRI = Ctx->ModeledFuncs.lookup(FName);
+		if (!FRI || !(FRI->Roles & FR_ERR_HANDLE)) 
 			continue;
 
 		// collect storeinst
@@ -570,9 +581,7 @@ bool SecurityChecksPass::mayReturnErr(Function *F) {
 					if (FName == "ERR_PTR" || FName == "PTR_ERR")
 						return true;
 					// Get the actual called function
-					if (Ctx->Callees[CI].size() == 0)
-						continue;
-					CF = *(Ctx->Callees[CI].begin());
+					CF = getFirstCallee(CI);
 					if (CF) {
 						EF.push_back(CF);
 						continue;
@@ -586,9 +595,7 @@ bool SecurityChecksPass::mayReturnErr(Function *F) {
 					if (!RV)
 						continue;
 					if (CallInst *RCI = dyn_cast<CallInst>(RV)) {
-						if (Ctx->Callees[RCI].size() == 0)
-							continue;
-						Function *RF = *(Ctx->Callees[RCI].begin());
+						Function *RF = getFirstCallee(RCI);
 						if (RF)
 							EF.push_back(RF);
 					}
@@ -610,13 +617,7 @@ void SecurityChecksPass::checkErrReturn(Function *F,
 	std::set<Value *> PV;
 	PV.clear();
 
-	for (inst_iterator i = inst_begin(F), e = inst_end(F);
-			i != e; ++i) {
-		ReturnInst *RI = dyn_cast<ReturnInst>(&*i);
-
-		if (!RI)
-			continue;
-
+	for (ReturnInst *RI : Ctx->getFuncFacts(F).Returns) {
 		// Backtrack returned value
 		checkErrValueFlow(F, RI, PV, bbErrMap);
 	}
@@ -628,51 +629,48 @@ void SecurityChecksPass::checkErrReturn(Function *F,
 void SecurityChecksPass::checkErrHandle(Function *F, 
 		BBErrMap &bbErrMap) {
 
-	for (Function::iterator b = F->begin(), e = F->end();
-			b != e; ++b) {
-		BasicBlock *BB = &*b;
-		for (BasicBlock::iterator I = BB->begin(),
-				IE = BB->end(); I != IE; ++I) {
-			CallInst *CI = dyn_cast<CallInst>(&*I);
-			if (CI) {
-				StringRef FuncName = getCalledFuncName(CI);
-
-				// For inline assembly code, just take the first substring
-				// without a space
-				if(FuncName.find(' ') != std::string::npos)
-					FuncName = FuncName.substr(0, FuncName.find(' '));
-
-				string funcName = FuncName.str();
-				if (FuncName.endswith("printk")) 
-					funcName = getSourceFuncName(CI);
-
-				auto FIter = Ctx->ErrorHandleFuncs.find(funcName);
-				// The called function handles an error, so mark the edge
-				if (FIter != Ctx->ErrorHandleFuncs.end()) {
-					markBBErr(BB, Must_Handle_Err, bbErrMap);
-					continue;
-				}
+	for (const CallFact &Call : Ctx->getFuncFacts(F).Calls) {
+		CallInst *CI = Call.CI;
+		BasicBlock *BB = CI->getParent();
+		StringRef FuncName = getCalledFuncName(CI);
+
+		// For inline assembly code, just take the first substring
+		// without a space
+		if(FuncName.find(' ') != std::string::npos)
+			FuncName = FuncName.substr(0, FuncName.find(' '));
+
+		const FuncRoleInfo *FRI;
+		if (FuncName.endswith("printk")) 
+			FRI = Ctx->ModeledFuncs.lookup(getSourceFuncName(CI));
+		else if (Call.Callee)
+			FRI = Ctx->ModeledFuncs.lookupCall(CI);
+		else
+			FRI = Ctx->ModeledFuncs.lookup(FuncName);
+
+		// The called function handles an error, so mark the edge
+		if (FRI && (FRI->Roles & FR_ERR_HANDLE)) {
+			markBBErr(BB, Must_Handle_Err, bbErrMap);
+			continue;
+		}
 
-				// Detect BUG, BUG_ON, WARN_ON more precisely
+		// Detect BUG, BUG_ON, WARN_ON more precisely
 #ifdef ASM_FUNC
-				if (FuncName.find("llvm") != std::string::npos || FuncName.empty())
-					continue;
+		if (FuncName.find("llvm") != std::string::npos || FuncName.empty())
+			continue;
 
-				smatch match;
-				string line;
-				getSourceCodeLine(CI, line);
+		smatch match;
+		string line;
+		getSourceCodeLine(CI, line);
 
-				if (regex_search(line, match, pattern)) {
-					auto FIter = Ctx->ErrorHandleFuncs.find(match[0].str());
+		if (regex_search(line, match, pattern)) {
+			FRI = Ctx->ModeledFuncs.lookup(match[0].str());
 
-					if (FIter != Ctx->ErrorHandleFuncs.end()) {
-						markBBErr(BB, Must_Handle_Err, bbErrMap);
-						continue;
-					}
-				}
-#endif
+			if (FRI && (FRI->Roles & FR_ERR_HANDLE)) {
+				markBBErr(BB, Must_Handle_Err, bbErrMap);
+				continue;
 			}
 		}
+#endif
 	}
 }
 
@@ -722,18 +720,19 @@ void SecurityChecksPass::identifySecurityChecks(Function *F,
 
 
 	// Filtering
-	if (edgeErrMap.size() == 0 	&& 
-			ErrSelectInstSet.size() == 0)
-		return;
+	{
+		lock_guard<mutex> Guard(ErrSelectLock);
+		if (edgeErrMap.size() == 0 	&& 
+				ErrSelectInstSet.size() == 0)
+			return;
+	}
 
 	//
 	// Find blocks that contain security checks by traversing the
 	// marked CFG represented by edgeErrMap
 	//
-	for (inst_iterator i = inst_begin(F), 
-			ei = inst_end(F); i != ei; ++i) {
+	for (Instruction *Inst : Ctx->getFuncFacts(F).CondInsts) {
 
-		Instruction *Inst = &*i;
 		Value *Cond = NULL;
 
 		// Case 1: branch instruction for checks
@@ -785,8 +784,11 @@ void SecurityChecksPass::identifySecurityChecks(Function *F,
 		// Case 3: select instruction for checks
 		else if (SelectInst *SI = dyn_cast<SelectInst>(Inst)) {
 			Ctx->NumCondStatements += 1;
-			if (ErrSelectInstSet.find(SI) == ErrSelectInstSet.end()) {
-				continue;
+			{
+				lock_guard<mutex> Guard(ErrSelectLock);
+				if (ErrSelectInstSet.find(SI) == ErrSelectInstSet.end()) {
+					continue;
+				}
 			}
 			// A security check
 			Cond = SI->getCondition();
@@ -916,6 +918,7 @@ void SecurityChecksPass::checkErrValueFlow(
 			else if (flag1 || flag2) {
 				markBBErr(SI->getParent(), May_Return_Err, bbErrMap);
 				// Only one branch in this case
+				lock_guard<mutex> Guard(ErrSelectLock);
 				ErrSelectInstSet.insert(SI);
 			}
 
@@ -954,11 +957,11 @@ void SecurityChecksPass::checkErrValueFlow(
 				continue;
 			}
 #endif
-			auto FIter = Ctx->CopyFuncs.find(FName.str());
-			if (FIter != Ctx->CopyFuncs.end()) {
-				if (get<1>(FIter->second) == -1) {
+			const FuncRoleInfo *FRI = Ctx->ModeledFuncs.lookupCall(CaI);
+			if (FRI && (FRI->Roles & FR_COPY)) {
+				if (FRI->CopyDst == -1) {
 					Value *Arg = 
-						CaI->getArgOperand(get<0>(FIter->second));
+						CaI->getArgOperand(FRI->CopySrc);
 					if (isValueErrno(Arg, F)) {
 						markBBErr(CaI->getParent(), Must_Return_Err, bbErrMap);
 						continue;
@@ -971,9 +974,7 @@ void SecurityChecksPass::checkErrValueFlow(
 				}
 			}
 			// Get the actual called function
-			if (Ctx->Callees[CaI].size() == 0)
-				continue;
-			CF = *(Ctx->Callees[CaI].begin());
+			CF = getFirstCallee(CaI);
 			if (!CF)
 				continue;
 			if (mayReturnErr(CF)) {
@@ -1136,8 +1137,26 @@ bool SecurityChecksPass::doFinalization(Module *M) {
   return false;
 }
 
+void SecurityChecksPass::recordChecks(Function *F,
+		set<SecurityCheck *> &SCSet) {
+
+	// Set of security checks.
+	if (SCSet.empty())
+		return;
+
+	Ctx->NumSecurityChecks += SCSet.size();
+	for (auto SC : SCSet) {
+		Ctx->SecurityCheckSets[F].insert(*SC);
+		Ctx->CheckInstSets[F].insert(SC->getSCheck());
+	}
+
+	if (OnChecks)
+		OnChecks(F);
+}
+
 bool SecurityChecksPass::doModulePass(Module *M) {
 
+	vector<Function *> Funcs;
 	for(Module::iterator f = M->begin(), fe = M->end();
 			f != fe; ++f) {
 		Function *F = &*f;
@@ -1151,22 +1170,48 @@ bool SecurityChecksPass::doModulePass(Module *M) {
 		if (Ctx->UnifiedFuncSet.find(F) == Ctx->UnifiedFuncSet.end())
 			continue;
 
-		// Marked CFG
-		EdgeErrMap edgeErrMap;
-		// Set of security checks.
-		set<SecurityCheck *> SCSet; 
-		// Traverse the CFG and find security checks for each errno.
-		identifySecurityChecks(F, edgeErrMap, SCSet);
+		if (!Ctx->isFocused(F) || !Ctx->isReachable(F))
+			continue;
+
+		Funcs.push_back(F);
+	}
 
-		if (SCSet.empty()) continue;
+	// Traverse the CFG and find security checks for each errno. 
+	// Without extra threads, the checks of each function are
+	// recorded and handled right after they are identified.
+	if (Ctx->NumThreads <= 1) {
+		for (Function *F : Funcs) {
+			if (Ctx->isPastChecksDeadline())
+				break;
 
-		Ctx->NumSecurityChecks += SCSet.size();
-		for (auto SC : SCSet) {
-			Ctx->SecurityCheckSets[F].insert(*SC);
-			Ctx->CheckInstSets[F].insert(SC->getSCheck());
+			// Marked CFG
+			EdgeErrMap edgeErrMap;
+			set<SecurityCheck *> SCSet;
+			identifySecurityChecks(F, edgeErrMap, SCSet);
+			recordChecks(F, SCSet);
 		}
+		return false;
+	}
 
-	} // End function iteration
+	vector<set<SecurityCheck *>> SCSets(Funcs.size());
+	DenseMap<Function *, unsigned> FuncIdx;
+	for (unsigned i = 0; i < Funcs.size(); ++i)
+		FuncIdx[Funcs[i]] = i;
+
+	// Otherwise functions are analyzed in parallel, and their checks
+	// are recorded in the order of functions
+	TaskScheduler Scheduler(Ctx, Ctx->NumThreads);
+	Scheduler.run(Funcs, [&](Function *F) {
+			if (Ctx->isPastChecksDeadline())
+				return;
+
+			// Marked CFG
+			EdgeErrMap edgeErrMap;
+			identifySecurityChecks(F, edgeErrMap, SCSets[FuncIdx[F]]);
+			});
+
+	for (unsigned i = 0; i < Funcs.size(); ++i)
+		recordChecks(Funcs[i], SCSets[i]);
 
 	return false;
 }
@@ -1,8 +1,11 @@
 #ifndef SECURITY_CHECKS_H
 #define SECURITY_CHECKS_H
 
+#include <mutex>
+
 #include "Analyzer.h"
 #include "Common.h"
+#include "TaskScheduler.h"
 
 
 
@@ -32,9 +35,20 @@ class SecurityChecksPass : public IterativeModulePass {
 	typedef std::map<BasicBlock *, int> BBErrMap;
 
 	static set<Instruction *>ErrSelectInstSet;
+	static mutex ErrSelectLock;
+
+	typedef function<void(Function *)> ChecksHandler;
 
 	private:
 
+	// Called on each function once its checks are recorded
+	ChecksHandler OnChecks;
+
+	Function *getFirstCallee(CallInst *CI);
+
+	// Record the identified checks of the function
+	void recordChecks(Function *F, set<SecurityCheck *> &SCSet);
+
 	// Dump marked edges.
 	void dumpErrEdges(EdgeErrMap &edgeErrMap);   // 下载边
 	bool isValueErrno(Value *V, Function *F);    //  //判断值是不是我们需要的常量、常量表达式等，若是，则返回true，否则false
@@ -107,6 +121,10 @@ class SecurityChecksPass : public IterativeModulePass {
 	virtual bool doFinalization(llvm::Module *);
 	virtual bool doModulePass(llvm::Module *);
 
+	// Process the checks of each function right after they are
+	// identified, while its IR is still hot in caches
+	void setChecksHandler(ChecksHandler H) { OnChecks = H; }
+
 	// Identify security checks.  遍历 CFG 并找到安全检查。这里还只是在条件语句层面
 	void identifySecurityChecks(Function *F, 
 			EdgeErrMap &edgeErrMap, 
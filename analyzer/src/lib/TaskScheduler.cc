@@ -0,0 +1,88 @@
+//===-- TaskScheduler.cc - Schedule per-function tasks------------===//
+//
+// This file implements a work-stealing scheduler that runs analyses
+// of functions on multiple threads.
+//
+//===-----------------------------------------------------------===//
+
+#include <thread>
+
+#include "TaskScheduler.h"
+
+uint64_t TaskScheduler::estimateCost(Function *F) {
+
+	// Slicing from each check may traverse the whole function
+	uint64_t NumChecks = 0;
+	auto It = Ctx->CheckInstSets.find(F);
+	if (It != Ctx->CheckInstSets.end())
+		NumChecks = It->second.size();
+
+	return F->getInstructionCount() + (uint64_t)F->size() * (1 + NumChecks);
+}
+
+void TaskScheduler::run(const vector<Function *> &Funcs, TaskFn Task) {
+
+	// Without extra threads, keep the order of functions
+	if (NumThreads == 1 || Funcs.size() < 2) {
+		for (Function *F : Funcs)
+			Task(F);
+		return;
+	}
+
+	vector<pair<uint64_t, Function *>> Costs;
+	for (Function *F : Funcs)
+		Costs.push_back(make_pair(estimateCost(F), F));
+	std::sort(Costs.begin(), Costs.end(),
+			[](const pair<uint64_t, Function *> &C1,
+				const pair<uint64_t, Function *> &C2) {
+			return C1.first > C2.first; });
+
+	unsigned NumWorkers = min<size_t>(NumThreads, Funcs.size());
+	Queues.clear();
+	for (unsigned i = 0; i < NumWorkers; ++i)
+		Queues.emplace_back(new WorkQueue());
+	for (size_t i = 0; i < Costs.size(); ++i)
+		Queues[i % NumWorkers]->Tasks.push_back(Costs[i].second);
+
+	vector<thread> Workers;
+	for (unsigned i = 1; i < NumWorkers; ++i)
+		Workers.emplace_back(&TaskScheduler::runWorker, this, i, ref(Task));
+	runWorker(0, Task);
+	for (thread &W : Workers)
+		W.join();
+}
+
+bool TaskScheduler::popTask(unsigned Worker, Function *&F) {
+
+	// The most expensive task of its own
+	{
+		WorkQueue &Q = *Queues[Worker];
+		lock_guard<mutex> Guard(Q.Lock);
+		if (!Q.Tasks.empty()) {
+			F = Q.Tasks.front();
+			Q.Tasks.pop_front();
+			return true;
+		}
+	}
+
+	// Steal the cheapest task of another worker
+	for (unsigned i = 1; i < Queues.size(); ++i) {
+		WorkQueue &Q = *Queues[(Worker + i) % Queues.size()];
+		lock_guard<mutex> Guard(Q.Lock);
+		if (!Q.Tasks.empty()) {
+			F = Q.Tasks.back();
+			Q.Tasks.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void TaskScheduler::runWorker(unsigned Worker, TaskFn &Task) {
+
+	// No task is added while running, so an empty round means done
+	Function *F;
+	while (popTask(Worker, F))
+		Task(F);
+}
@@ -0,0 +1,48 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include "Analyzer.h"
+
+//
+// Work-stealing scheduler of per-function tasks. Function sizes are
+// heavily skewed, so tasks are sorted by an estimated cost and dealt
+// round-robin to per-worker deques, largest first. A worker takes
+// tasks from the front of its own deque, and once it is empty, steals
+// from the back of the others, i.e., the cheapest tasks, so that the
+// expensive ones start early and the tail is balanced.
+//
+class TaskScheduler {
+
+	public:
+		typedef function<void(Function *)> TaskFn;
+
+		TaskScheduler(GlobalContext *Ctx_, unsigned NumThreads_)
+			: Ctx(Ctx_), NumThreads(NumThreads_ ? NumThreads_ : 1) {}
+
+		// Run the task on each function, and return when all are
+		// done. Tasks must only touch per-function state, or
+		// synchronize themselves.
+		void run(const vector<Function *> &Funcs, TaskFn Task);
+
+		// Estimated cost of analyzing the function
+		uint64_t estimateCost(Function *F);
+
+	private:
+		struct WorkQueue {
+			mutex Lock;
+			deque<Function *> Tasks;
+		};
+
+		bool popTask(unsigned Worker, Function *&F);
+		void runWorker(unsigned Worker, TaskFn &Task);
+
+		GlobalContext *Ctx;
+		unsigned NumThreads;
+		vector<unique_ptr<WorkQueue>> Queues;
+};
+
+#endif
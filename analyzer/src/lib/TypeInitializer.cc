@@ -33,46 +33,44 @@ bool TypeInitializerPass::doInitialization(Module *M) {
 		}
 	}
 	
-	// Initializing StructTNMap
-	// Map global variable name to their struct type name
-	for (Module::iterator ff = M->begin(),
-			MEnd = M->end();ff != MEnd; ++ff) {
-		Function *Func = &*ff;
-		if (Func->isIntrinsic())
+	return false;
+}
+bool TypeInitializerPass::doFinalization(Module *M) {
+	return false;
+}
+
+// Map the names of values of struct types used by the instruction
+// to the names of their types
+void TypeInitializerPass::visitOperands(Instruction *Inst) {
+
+	unsigned T = Inst->getNumOperands();
+	for(int i = 0; i < T; i++) {
+		Value *VI = Inst->getOperand(i);
+		if (!VI)
+			continue;
+		if (!VI->hasName())
+			continue;
+		Type *VT = VI->getType();
+		while(VT && VT->isPointerTy())
+			VT = VT->getPointerElementType();
+		if (!VT)
 			continue;
-		for (inst_iterator ii = inst_begin(Func), e = inst_end(Func);
-					ii != e; ++ii) {
-			Instruction *Inst = &*ii;
-			unsigned T = Inst->getNumOperands();
-			for(int i = 0; i < T; i++) {
-				Value *VI = Inst->getOperand(i);
-				if (!VI)
-					continue;
-				if (!VI->hasName())
-					continue;
-				Type *VT = VI->getType();
-				while(VT && VT->isPointerTy())
-					VT = VT->getPointerElementType();
-				if (!VT)
-					continue;
 
-				if (StructType *SVT = dyn_cast<StructType>(VT)) {
-					if(!VI->hasName() || !SVT->hasName())
-						continue;
-					string ValueName = VI->getName();
-					string StructName = SVT->getName();
-					//OP<<ValueName<<"\t"<<StructName<<"\n";
-					VnameToTypenameMap.insert(pair<string, string>(ValueName,StructName));
-				}
-	
-			}
+		if (StructType *SVT = dyn_cast<StructType>(VT)) {
+			if(!VI->hasName() || !SVT->hasName())
+				continue;
+			string ValueName = VI->getName();
+			string StructName = SVT->getName();
+			//OP<<ValueName<<"\t"<<StructName<<"\n";
+			VnameToTypenameMap.insert(pair<string, string>(ValueName,StructName));
 		}
+
 	}
-	
-	return false;
 }
-bool TypeInitializerPass::doFinalization(Module *M) {
-	return false;
+
+// Initializing StructTNMap by the fused scan of instructions
+void TypeInitializerPass::registerHandlers(InstScanner &Scanner) {
+	Scanner.addHandler([this](Instruction *I) { visitOperands(I); });
 }
 
 void TypeInitializerPass::BuildTypeStructMap(){
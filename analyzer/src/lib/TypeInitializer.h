@@ -9,4 +9,10 @@ class TypeInitializerPass : public IterativeModulePass {
 		virtual bool doFinalization(llvm::Module *);
 		virtual bool doModulePass(llvm::Module *);
 		void BuildTypeStructMap();
+
+		// Register the handlers of the fused instruction scan
+		void registerHandlers(InstScanner &Scanner);
+
+	private:
+		void visitOperands(Instruction *Inst);
 };